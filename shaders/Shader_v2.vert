@@ -1,11 +1,38 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+// Per frame, dynamic offset into the uniform ring
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProjection;
+    vec4 visibleRegion;    // xy = min, zw = max, read by the cull pass
+} camera;
+
+struct Material {
+    vec4 color;
+};
+
+// Global bindless table, storage buffers are picked by handle
+layout(std430, set = 1, binding = 1) readonly buffer Materials {
+    Material materials[];
+} buffers[];
+
+// Per draw
+layout(push_constant) uniform Draw {
+    vec4 transform;    // xy = offset, zw = scale
+    uint materialBuffer;    // Bindless buffer handle
+    uint material;    // Index into that buffer
+    uint texture;    // Bindless texture handle, read by the fragment shader
+} draw;
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+    vec2 position = inPosition * draw.transform.zw + draw.transform.xy;
+    gl_Position = camera.viewProjection * vec4(position, 0.0, 1.0);
+    fragColor = inColor * buffers[draw.materialBuffer].materials[draw.material].color.rgb;
+    fragTexCoord = inPosition + 0.5;
 }
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+// Per frame, dynamic offset into the uniform ring
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProjection;
+    vec4 visibleRegion;    // xy = min, zw = max, read by the cull pass
+} camera;
+
+struct Instance {
+    vec4 transform;    // xy = offset, zw = scale
+    vec4 color;
+};
+
+// Global bindless table, both the instance data and the cull pass's visible list are picked by handle
+layout(std430, set = 1, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceBuffers[];
+
+layout(std430, set = 1, binding = 1) readonly buffer VisibleInstances {
+    uint visible[];
+} visibleBuffers[];
+
+// Per draw, the rest of the block is read by the fragment shader
+layout(push_constant) uniform Draw {
+    layout(offset = 28) uint instanceBuffer;    // Bindless buffer handle of the instance data
+    uint visibleInstances;    // Bindless buffer handle of the indices the cull pass kept
+} draw;
+
+void main() {
+    // Only the visible instances are drawn, gl_InstanceIndex counts those
+    uint id = visibleBuffers[draw.visibleInstances].visible[gl_InstanceIndex];
+    vec4 transform = instanceBuffers[draw.instanceBuffer].instances[id].transform;
+
+    vec2 position = inPosition * transform.zw + transform.xy;
+    gl_Position = camera.viewProjection * vec4(position, 0.0, 1.0);
+    fragColor = inColor * instanceBuffers[draw.instanceBuffer].instances[id].color.rgb;
+    fragTexCoord = inPosition + 0.5;
+}
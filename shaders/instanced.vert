@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// Per instance
+layout(location = 2) in vec4 inTransform;    // xy = offset, zw = scale
+layout(location = 3) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+// Per frame, dynamic offset into the uniform ring
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProjection;
+    vec4 visibleRegion;    // xy = min, zw = max, read by the cull pass
+} camera;
+
+void main() {
+    vec2 position = inPosition * inTransform.zw + inTransform.xy;
+    gl_Position = camera.viewProjection * vec4(position, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor.rgb;
+    fragTexCoord = inPosition + 0.5;
+}
@@ -1,9 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
+// Global bindless table, textures are picked by handle
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// Per draw, the rest of the block is read by the vertex shader
+layout(push_constant) uniform Draw {
+    layout(offset = 24) uint texture;
+} draw;
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(fragColor, 1.0) * texture(textures[draw.texture], fragTexCoord);
 }
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeBenchmark::configure(unsigned int warmupFrames, unsigned int timedFrames)
+	{
+		warmupFrameCount = warmupFrames;
+		timedFrameCount = timedFrames;
+		frameIndex = 0;
+		metrics.clear();
+	}
+
+	void MgeBenchmark::beginFrame()
+	{
+		if (isEnabled() && frameIndex == warmupFrameCount)
+		{
+			timedStart = Clock::now();
+		}
+	}
+
+	void MgeBenchmark::endFrame()
+	{
+		if (!isEnabled() || isFinished())
+		{
+			return;
+		}
+
+		frameIndex++;
+
+		if (isFinished())
+		{
+			timedEnd = Clock::now();
+		}
+	}
+
+	void MgeBenchmark::addSample(const std::string& metric, double value)
+	{
+		if (!isTiming())
+		{
+			return;
+		}
+
+		for (auto& series : metrics)
+		{
+			if (series.first == metric)
+			{
+				series.second.push_back(value);
+				return;
+			}
+		}
+
+		metrics.emplace_back(metric, std::vector<double>{ value });
+		metrics.back().second.reserve(timedFrameCount);
+	}
+
+	void MgeBenchmark::setInfo(const std::string& key, const std::string& value)
+	{
+		for (auto& entry : info)
+		{
+			if (entry.first == key)
+			{
+				entry.second = value;
+				return;
+			}
+		}
+
+		info.emplace_back(key, value);
+	}
+
+	std::vector<double> MgeBenchmark::getSamples(const std::string& metric) const
+	{
+		for (const auto& series : metrics)
+		{
+			if (series.first == metric)
+			{
+				return series.second;
+			}
+		}
+
+		return {};
+	}
+
+	MgeBenchmark::Statistics MgeBenchmark::computeStatistics(std::vector<double> samples)
+	{
+		Statistics stats{};
+
+		if (samples.empty())
+		{
+			return stats;
+		}
+
+		std::sort(samples.begin(), samples.end());
+
+		// Nearest-rank percentile on the sorted samples
+		auto percentile = [&samples](double p)
+		{
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+			return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+		};
+
+		stats.count = samples.size();
+		stats.min = samples.front();
+		stats.max = samples.back();
+		stats.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+		stats.p50 = percentile(50.0);
+		stats.p95 = percentile(95.0);
+		stats.p99 = percentile(99.0);
+
+		return stats;
+	}
+
+	double MgeBenchmark::getTimedSeconds() const
+	{
+		return std::chrono::duration<double>(timedEnd - timedStart).count();
+	}
+
+	double MgeBenchmark::millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void MgeBenchmark::printReport(std::ostream& out) const
+	{
+		double timedSeconds = getTimedSeconds();
+
+		out << "\n==== Benchmark : " << warmupFrameCount << " warm-up + " << timedFrameCount << " timed frames ====\n";
+
+		for (const auto& entry : info)
+		{
+			out << "  " << entry.first << " : " << entry.second << "\n";
+		}
+
+		if (timedSeconds > 0.0)
+		{
+			out << "  wall time : " << std::fixed << std::setprecision(3) << timedSeconds << " s ("
+				<< std::setprecision(1) << timedFrameCount / timedSeconds << " fps)\n";
+		}
+
+		out << "\n  " << std::left << std::setw(28) << "metric" << std::right
+			<< std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p50"
+			<< std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+		out << std::fixed << std::setprecision(3);
+
+		for (const auto& series : metrics)
+		{
+			Statistics stats = computeStatistics(series.second);
+
+			out << "  " << std::left << std::setw(28) << series.first << std::right
+				<< std::setw(10) << stats.min << std::setw(10) << stats.avg << std::setw(10) << stats.p50
+				<< std::setw(10) << stats.p95 << std::setw(10) << stats.p99 << std::setw(10) << stats.max << "\n";
+		}
+
+		out << std::defaultfloat << std::endl;
+	}
+
+	void MgeBenchmark::writeJsonReport(const std::string& filename) const
+	{
+		std::ofstream file(filename, std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open benchmark report : " + filename);
+		}
+
+		double timedSeconds = getTimedSeconds();
+
+		file << std::setprecision(6) << std::fixed;
+		file << "{\n";
+		file << "  \"warmup_frames\": " << warmupFrameCount << ",\n";
+		file << "  \"timed_frames\": " << timedFrameCount << ",\n";
+		file << "  \"wall_time_s\": " << timedSeconds << ",\n";
+		file << "  \"avg_fps\": " << (timedSeconds > 0.0 ? timedFrameCount / timedSeconds : 0.0) << ",\n";
+
+		file << "  \"info\": {";
+
+		for (size_t i = 0; i < info.size(); i++)
+		{
+			file << (i == 0 ? "\n" : ",\n") << "    \"" << escapeJson(info[i].first) << "\": \"" << escapeJson(info[i].second) << "\"";
+		}
+
+		file << "\n  },\n";
+		file << "  \"metrics\": {";
+
+		for (size_t i = 0; i < metrics.size(); i++)
+		{
+			Statistics stats = computeStatistics(metrics[i].second);
+
+			file << (i == 0 ? "\n" : ",\n") << "    \"" << escapeJson(metrics[i].first) << "\": { "
+				<< "\"count\": " << stats.count << ", "
+				<< "\"min\": " << stats.min << ", "
+				<< "\"avg\": " << stats.avg << ", "
+				<< "\"p50\": " << stats.p50 << ", "
+				<< "\"p95\": " << stats.p95 << ", "
+				<< "\"p99\": " << stats.p99 << ", "
+				<< "\"max\": " << stats.max << " }";
+		}
+
+		file << "\n  }\n";
+		file << "}\n";
+	}
+
+	std::string MgeBenchmark::escapeJson(const std::string& text)
+	{
+		std::string escaped;
+		escaped.reserve(text.size());
+
+		for (char c : text)
+		{
+			switch (c)
+			{
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) >= 0x20)
+				{
+					escaped += c;
+				}
+			}
+		}
+
+		return escaped;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mge {
+
+	/*
+	* Frame benchmark harness
+	*
+	* Runs a fixed number of warm-up frames (driver shader compiles, first-use allocations and
+	* clock ramp-up land here and are thrown away) followed by a fixed number of timed frames.
+	* During the timed frames any part of the engine can add samples to a named metric, for
+	* example "cpu_frame_ms" or "frame_wait_ms". At the end each metric is reduced to
+	* min / avg / p50 / p95 / p99 / max, printed and written out as a JSON report so runs can be
+	* compared against each other.
+	*/
+	class MgeBenchmark
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		struct Statistics
+		{
+			unsigned long long count = 0;
+			double min = 0.0;
+			double avg = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		void configure(unsigned int warmupFrames, unsigned int timedFrames);
+
+		bool isEnabled() const { return timedFrameCount > 0; }
+
+		// True while the current frame is one of the timed frames
+		bool isTiming() const { return isEnabled() && frameIndex >= warmupFrameCount && !isFinished(); }
+
+		bool isFinished() const { return isEnabled() && frameIndex >= warmupFrameCount + timedFrameCount; }
+
+		unsigned long long getTotalFrames() const { return static_cast<unsigned long long>(warmupFrameCount) + timedFrameCount; }
+
+		unsigned int getTimedFrames() const { return timedFrameCount; }
+
+		// Wall-clock time of the timed frames, valid once isFinished()
+		double getTimedSeconds() const;
+
+		void beginFrame();
+
+		void endFrame();
+
+		// Samples are only kept for timed frames, so callers can add them unconditionally
+		void addSample(const std::string& metric, double value);
+
+		// Free-form context written into the report (device name, present mode, ...)
+		void setInfo(const std::string& key, const std::string& value);
+
+		std::vector<double> getSamples(const std::string& metric) const;
+
+		static Statistics computeStatistics(std::vector<double> samples);
+
+		static double millisecondsSince(Clock::time_point start);
+
+		void printReport(std::ostream& out) const;
+
+		void writeJsonReport(const std::string& filename) const;
+
+	private:
+		unsigned int warmupFrameCount = 0;
+		unsigned int timedFrameCount = 0;
+		unsigned long long frameIndex = 0;
+
+		Clock::time_point timedStart;
+		Clock::time_point timedEnd;
+
+		// Kept in insertion order so the report lists metrics in the order the engine produces them
+		std::vector<std::pair<std::string, std::vector<double>>> metrics;
+		std::vector<std::pair<std::string, std::string>> info;
+
+		static std::string escapeJson(const std::string& text);
+	};
+}
@@ -0,0 +1,172 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeBindlessTable::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, MgeDescriptorLayoutCache& layoutCache,
+		uint32_t maxTextures, uint32_t maxBuffers)
+	{
+		device = logicalDevice;
+
+		// Clamp the arrays to what the device allows in one update-after-bind set and stage
+		VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+		vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &vulkan12Properties;
+
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+		// Combined image samplers count as sampled images and as samplers
+		textures.capacity = std::min({ maxTextures, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages, vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers });
+		buffers.capacity = std::min({ maxBuffers, vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+		// Both bindings (all stages) also share one per-stage resource limit with the engine's other sets
+		uint32_t resourceLimit = vulkan12Properties.maxPerStageUpdateAfterBindResources > OTHER_SET_RESOURCES ?
+			vulkan12Properties.maxPerStageUpdateAfterBindResources - OTHER_SET_RESOURCES : 0;
+
+		if (textures.capacity + static_cast<uint64_t>(buffers.capacity) > resourceLimit)
+		{
+			// Scale both down, keeping the ratio between them
+			uint64_t total = static_cast<uint64_t>(textures.capacity) + buffers.capacity;
+
+			textures.capacity = static_cast<uint32_t>(static_cast<uint64_t>(textures.capacity) * resourceLimit / total);
+			buffers.capacity = resourceLimit - textures.capacity;
+		}
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[TEXTURE_BINDING].binding = TEXTURE_BINDING;
+		bindings[TEXTURE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[TEXTURE_BINDING].descriptorCount = textures.capacity;
+		bindings[TEXTURE_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+
+		bindings[BUFFER_BINDING].binding = BUFFER_BINDING;
+		bindings[BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[BUFFER_BINDING].descriptorCount = buffers.capacity;
+		bindings[BUFFER_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+
+		// Entries are written while frames that bound the set are still pending, those frames never read them
+		VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+		layout = layoutCache.getLayout(std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()), { bindingFlags, bindingFlags });
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.capacity };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<unsigned int>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate bindless descriptor set!");
+		}
+	}
+
+	void MgeBindlessTable::destroy()
+	{
+		// Only called once the device is idle, destroying the pool frees the set
+		if (pool != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+			pool = VK_NULL_HANDLE;
+		}
+
+		set = VK_NULL_HANDLE;
+		textures = HandleArray{};
+		buffers = HandleArray{};
+	}
+
+	uint32_t MgeBindlessTable::registerTexture(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout)
+	{
+		uint32_t handle = textures.acquire();
+
+		VkDescriptorImageInfo imageInfo{ sampler, imageView, imageLayout };
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = TEXTURE_BINDING;
+		descriptorWrite.dstArrayElement = handle;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		// Update after bind, fine while command buffers using the set are pending
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		return handle;
+	}
+
+	uint32_t MgeBindlessTable::registerBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		uint32_t handle = buffers.acquire();
+
+		VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = BUFFER_BINDING;
+		descriptorWrite.dstArrayElement = handle;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		return handle;
+	}
+
+	void MgeBindlessTable::releaseTexture(uint32_t handle)
+	{
+		// The stale descriptor stays until the handle is reused, partially bound allows that as long as nothing reads it
+		textures.freeHandles.push_back(handle);
+	}
+
+	void MgeBindlessTable::releaseBuffer(uint32_t handle)
+	{
+		buffers.freeHandles.push_back(handle);
+	}
+
+	uint32_t MgeBindlessTable::HandleArray::acquire()
+	{
+		if (!freeHandles.empty())
+		{
+			uint32_t handle = freeHandles.back();
+			freeHandles.pop_back();
+
+			return handle;
+		}
+
+		if (count == capacity)
+		{
+			throw std::runtime_error("Bindless descriptor table is full!");
+		}
+
+		return count++;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "DescriptorLayoutCache.h"
+
+namespace mge {
+
+	// Handle value that never refers to a registered resource
+	const uint32_t MGE_INVALID_BINDLESS_HANDLE = UINT32_MAX;
+
+	/*
+	* Global bindless descriptor table
+	*
+	* One descriptor set, allocated once and bound once per command buffer, holding large arrays of
+	* every texture and storage buffer the engine registers:
+	*
+	*     binding 0 : combined image samplers   layout(set = 1, binding = 0) uniform sampler2D textures[];
+	*     binding 1 : storage buffers           layout(set = 1, binding = 1) buffer B { ... } buffers[];
+	*
+	* Registering a resource writes its descriptor and returns an integer handle (its array index).
+	* Shaders pick resources by handle from push constants or instance data, so draws with different
+	* resources need no descriptor binds in between and can share one (indirect) draw call.
+	*
+	* Both bindings are UPDATE_AFTER_BIND, UPDATE_UNUSED_WHILE_PENDING and PARTIALLY_BOUND: resources
+	* can be registered while command buffers using the set are pending (as long as those never read
+	* the new entry), and unused entries may stay unwritten. A released
+	* handle goes back on the free list right away, so only release it once no submission in flight
+	* can still read it (through the engine's deletion queue, for example).
+	*/
+	class MgeBindlessTable
+	{
+	public:
+		void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, MgeDescriptorLayoutCache& layoutCache,
+			uint32_t maxTextures = 4096, uint32_t maxBuffers = 1024);
+
+		void destroy();
+
+		uint32_t registerTexture(VkSampler sampler, VkImageView imageView,
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		uint32_t registerBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+		void releaseTexture(uint32_t handle);
+
+		void releaseBuffer(uint32_t handle);
+
+		VkDescriptorSetLayout getLayout() const { return layout; }
+
+		VkDescriptorSet getSet() const { return set; }
+
+		uint32_t getTextureCount() const { return textures.count - static_cast<uint32_t>(textures.freeHandles.size()); }
+
+		uint32_t getBufferCount() const { return buffers.count - static_cast<uint32_t>(buffers.freeHandles.size()); }
+
+	private:
+		static const uint32_t TEXTURE_BINDING = 0;
+		static const uint32_t BUFFER_BINDING = 1;
+
+		// Per-stage resources left to the sets bound next to this one (camera, culling)
+		static const uint32_t OTHER_SET_RESOURCES = 16;
+
+		// Handles of one binding, the array grows up to capacity and freed entries are reused first
+		struct HandleArray
+		{
+			uint32_t capacity = 0;
+			uint32_t count = 0;
+			std::vector<uint32_t> freeHandles;
+
+			uint32_t acquire();
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;	// Owned by the layout cache
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+
+		HandleArray textures;
+		HandleArray buffers;
+	};
+}
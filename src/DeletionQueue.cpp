@@ -0,0 +1,34 @@
+#include "DeletionQueue.h"
+
+#include <utility>
+
+namespace mge {
+
+	void MgeDeletionQueue::push(unsigned long long lastSubmission, std::function<void()> destroyFunction)
+	{
+		entries.push_back({ lastSubmission, std::move(destroyFunction) });
+	}
+
+	void MgeDeletionQueue::flush(unsigned long long completedSubmission)
+	{
+		// Serials only grow, so everything that is ready sits at the front of the queue
+		while (!entries.empty() && entries.front().lastSubmission <= completedSubmission)
+		{
+			std::function<void()> destroyFunction = std::move(entries.front().destroyFunction);
+			entries.pop_front();
+
+			destroyFunction();
+		}
+	}
+
+	void MgeDeletionQueue::flushAll()
+	{
+		while (!entries.empty())
+		{
+			std::function<void()> destroyFunction = std::move(entries.front().destroyFunction);
+			entries.pop_front();
+
+			destroyFunction();
+		}
+	}
+}
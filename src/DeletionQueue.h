@@ -0,0 +1,44 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+
+namespace mge {
+
+	/*
+	* Frame-fenced deferred destruction
+	*
+	* Vulkan objects can not be destroyed while a submitted command buffer may still use them.
+	* Instead of draining the device with vkDeviceWaitIdle, the object is handed to this queue
+	* together with the serial of the last submission that can reference it:
+	*
+	*     deletionQueue.push(lastSubmission, [=]() { vkDestroyFramebuffer(device, frameBuffer, nullptr); });
+	*
+	* Every time the engine learns that a submission has completed (the frame timeline semaphore has
+	* reached its serial) it calls flush(completedSubmission), which runs the destroy functions of everything retired up
+	* to that serial. Entries run in the order they were pushed, so dependent objects can be retired
+	* in the same order they would be destroyed immediately.
+	*/
+	class MgeDeletionQueue
+	{
+	public:
+		void push(unsigned long long lastSubmission, std::function<void()> destroyFunction);
+
+		// Destroys everything whose last submission is <= completedSubmission
+		void flush(unsigned long long completedSubmission);
+
+		// Destroys everything, only call once the device is idle
+		void flushAll();
+
+		bool isEmpty() const { return entries.empty(); }
+
+	private:
+		struct Entry
+		{
+			unsigned long long lastSubmission;
+			std::function<void()> destroyFunction;
+		};
+
+		std::deque<Entry> entries;
+	};
+}
@@ -0,0 +1,252 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace mge {
+
+	MgeDescriptorWrite MgeDescriptorWrite::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+		VkDeviceSize offset, VkDeviceSize range)
+	{
+		MgeDescriptorWrite write;
+		write.binding = binding;
+		write.type = type;
+		write.bufferInfo = { buffer, offset, range };
+
+		return write;
+	}
+
+	MgeDescriptorWrite MgeDescriptorWrite::image(uint32_t binding, VkDescriptorType type, VkSampler sampler,
+		VkImageView imageView, VkImageLayout imageLayout)
+	{
+		MgeDescriptorWrite write;
+		write.binding = binding;
+		write.type = type;
+		write.imageInfo = { sampler, imageView, imageLayout };
+		write.isImage = true;
+
+		return write;
+	}
+
+	void MgeDescriptorAllocator::init(VkDevice logicalDevice, unsigned int slotCount)
+	{
+		device = logicalDevice;
+		slots.resize(slotCount);
+		currentSlot = 0;
+		nextPoolSets = FIRST_POOL_SETS;
+	}
+
+	void MgeDescriptorAllocator::destroy()
+	{
+		// Only called once the device is idle, destroying a pool frees its sets
+		for (auto& slot : slots)
+		{
+			for (auto pool : slot.pools)
+			{
+				vkDestroyDescriptorPool(device, pool, nullptr);
+			}
+		}
+
+		for (auto pool : freePools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+
+		slots.clear();
+		freePools.clear();
+	}
+
+	void MgeDescriptorAllocator::beginFrame(unsigned int slot)
+	{
+		if (slot >= slots.size())
+		{
+			throw std::runtime_error("Descriptor allocator slot out of range!");
+		}
+
+		currentSlot = slot;
+
+		Slot& current = slots[slot];
+
+		bool stale = std::any_of(current.sets.begin(), current.sets.end(), [](const auto& entry) { return !entry.second.used; });
+
+		if (stale)
+		{
+			// Everything goes at once, the sets that are still wanted get allocated again this frame
+			for (auto pool : current.pools)
+			{
+				vkResetDescriptorPool(device, pool, 0);
+				freePools.push_back(pool);
+			}
+
+			current.pools.clear();
+			current.sets.clear();
+
+			stats.poolResets++;
+		}
+
+		for (auto& [key, cached] : current.sets)
+		{
+			cached.used = false;
+		}
+	}
+
+	VkDescriptorSet MgeDescriptorAllocator::allocate(VkDescriptorSetLayout layout, const std::vector<MgeDescriptorWrite>& writes)
+	{
+		Slot& slot = slots[currentSlot];
+
+		SetKey key = makeKey(layout, writes);
+
+		auto found = slot.sets.find(key);
+
+		// Same layout and contents as a set this slot already has, nothing to allocate or write
+		if (found != slot.sets.end())
+		{
+			found->second.used = true;
+			stats.cacheHits++;
+
+			return found->second.set;
+		}
+
+		VkDescriptorSet set = allocateSet(slot, layout);
+
+		std::vector<VkWriteDescriptorSet> descriptorWrites(writes.size());
+
+		for (size_t i = 0; i < writes.size(); i++)
+		{
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = set;
+			descriptorWrites[i].dstBinding = writes[i].binding;
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].descriptorType = writes[i].type;
+
+			if (writes[i].isImage)
+			{
+				descriptorWrites[i].pImageInfo = &writes[i].imageInfo;
+			}
+			else
+			{
+				descriptorWrites[i].pBufferInfo = &writes[i].bufferInfo;
+			}
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<unsigned int>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+		slot.sets.emplace(std::move(key), CachedSet{ set, true });
+
+		return set;
+	}
+
+	VkDescriptorPool MgeDescriptorAllocator::takePool()
+	{
+		if (!freePools.empty())
+		{
+			VkDescriptorPool pool = freePools.back();
+			freePools.pop_back();
+
+			return pool;
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes;
+
+		for (const auto& poolRatio : poolRatios)
+		{
+			poolSizes.push_back({ poolRatio.type, std::max(1u, static_cast<unsigned int>(poolRatio.ratio * nextPoolSets)) });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = nextPoolSets;
+		poolInfo.poolSizeCount = static_cast<unsigned int>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor pool!");
+		}
+
+		// Every pool created is bigger than the last, a growing frame needs fewer and fewer new ones
+		nextPoolSets = std::min(nextPoolSets * 2, MAX_POOL_SETS);
+		stats.poolsCreated++;
+
+		return pool;
+	}
+
+	VkDescriptorSet MgeDescriptorAllocator::allocateSet(Slot& slot, VkDescriptorSetLayout layout)
+	{
+		if (slot.pools.empty())
+		{
+			slot.pools.push_back(takePool());
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = slot.pools.back();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+
+		// The current pool is full, move on to another one and try once more
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			slot.pools.push_back(takePool());
+			allocInfo.descriptorPool = slot.pools.back();
+
+			result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate descriptor set!");
+		}
+
+		stats.setsAllocated++;
+
+		return set;
+	}
+
+	MgeDescriptorAllocator::SetKey MgeDescriptorAllocator::makeKey(VkDescriptorSetLayout layout, const std::vector<MgeDescriptorWrite>& writes) const
+	{
+		SetKey key;
+		key.words.reserve(2 + writes.size() * 5);
+		key.words.push_back(generation);
+		key.words.push_back(reinterpret_cast<uint64_t>(layout));
+
+		for (const auto& write : writes)
+		{
+			key.words.push_back((static_cast<uint64_t>(write.binding) << 32) | static_cast<uint64_t>(write.type));
+
+			if (write.isImage)
+			{
+				key.words.push_back(reinterpret_cast<uint64_t>(write.imageInfo.sampler));
+				key.words.push_back(reinterpret_cast<uint64_t>(write.imageInfo.imageView));
+				key.words.push_back(static_cast<uint64_t>(write.imageInfo.imageLayout));
+			}
+			else
+			{
+				key.words.push_back(reinterpret_cast<uint64_t>(write.bufferInfo.buffer));
+				key.words.push_back(write.bufferInfo.offset);
+				key.words.push_back(write.bufferInfo.range);
+			}
+		}
+
+		return key;
+	}
+
+	size_t MgeDescriptorAllocator::SetKeyHash::operator()(const SetKey& key) const
+	{
+		size_t hash = key.words.size();
+
+		for (uint64_t word : key.words)
+		{
+			hash ^= std::hash<uint64_t>()(word) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace mge {
+
+	// One descriptor of a set, see MgeDescriptorAllocator::allocate
+	struct MgeDescriptorWrite
+	{
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorBufferInfo bufferInfo{};
+		VkDescriptorImageInfo imageInfo{};
+		bool isImage = false;
+
+		static MgeDescriptorWrite buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+			VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+		static MgeDescriptorWrite image(uint32_t binding, VkDescriptorType type, VkSampler sampler,
+			VkImageView imageView, VkImageLayout imageLayout);
+	};
+
+	/*
+	* Growable per-frame descriptor allocator
+	*
+	* Every slot (the same slots the GPU profiler and the uniform ring use) owns its own descriptor
+	* pools. Sets are never freed one by one: when a slot comes around again its pools are reset
+	* wholesale with vkResetDescriptorPool. When a pool runs out a new one is taken, each new pool
+	* holding more sets than the last, so the allocator grows to whatever a frame needs.
+	*
+	*     descriptors.beginFrame(slot);    // slot's previous submission has finished
+	*     VkDescriptorSet set = descriptors.allocate(layout, {
+	*         MgeDescriptorWrite::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ringBuffer, 0, sizeof(CameraData)) });
+	*
+	* Fast path: sets are keyed by their layout and contents. A request matching a set the slot handed
+	* out last time returns that set again, without allocating or writing anything. The slot's pools are
+	* only reset when its last frame left sets behind that nobody asked for any more (contents changed),
+	* so a frame whose bindings did not change does no descriptor work at all.
+	*
+	* A set stays valid until the next beginFrame of its slot that finds stale sets. Only call beginFrame
+	* once no submission still in flight uses the slot's sets.
+	*
+	* Sets are keyed by raw handle values, and a destroyed buffer's handle may well come back for a new
+	* one. Call invalidate() whenever a resource a cached set may reference is destroyed: no cached set
+	* matches any more, and every slot resets its pools the next time it comes around.
+	*/
+	class MgeDescriptorAllocator
+	{
+	public:
+		struct Stats
+		{
+			unsigned long long setsAllocated = 0;
+			unsigned long long cacheHits = 0;
+			unsigned long long poolResets = 0;
+			unsigned int poolsCreated = 0;
+		};
+
+		void init(VkDevice logicalDevice, unsigned int slotCount);
+
+		void destroy();
+
+		void beginFrame(unsigned int slot);
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout, const std::vector<MgeDescriptorWrite>& writes);
+
+		// Sets handed out so far are never returned again, safe while they are still in flight
+		void invalidate() { generation++; }
+
+		const Stats& getStats() const { return stats; }
+
+	private:
+		struct SetKey
+		{
+			std::vector<uint64_t> words;	// Generation and layout handle followed by every write, flattened
+
+			bool operator==(const SetKey& other) const { return words == other.words; }
+		};
+
+		struct SetKeyHash
+		{
+			size_t operator()(const SetKey& key) const;
+		};
+
+		struct CachedSet
+		{
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			bool used = false;	// Requested since the slot's last beginFrame
+		};
+
+		struct Slot
+		{
+			std::vector<VkDescriptorPool> pools;	// Last one is the one being allocated from
+			std::unordered_map<SetKey, CachedSet, SetKeyHash> sets;
+		};
+
+		// Descriptors per set of each type, scaled by the sets per pool
+		struct PoolRatio
+		{
+			VkDescriptorType type;
+			float ratio;
+		};
+
+		static const unsigned int FIRST_POOL_SETS = 64;
+		static const unsigned int MAX_POOL_SETS = 4096;
+
+		const std::vector<PoolRatio> poolRatios =
+		{
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		std::vector<Slot> slots;
+		unsigned int currentSlot = 0;
+
+		std::vector<VkDescriptorPool> freePools;	// Reset pools, shared by all slots
+		unsigned int nextPoolSets = FIRST_POOL_SETS;
+
+		unsigned long long generation = 0;	// Bumped by invalidate(), part of every key
+
+		Stats stats;
+
+		VkDescriptorPool takePool();
+
+		VkDescriptorSet allocateSet(Slot& slot, VkDescriptorSetLayout layout);
+
+		SetKey makeKey(VkDescriptorSetLayout layout, const std::vector<MgeDescriptorWrite>& writes) const;
+	};
+}
@@ -0,0 +1,149 @@
+#include "DescriptorLayoutCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeDescriptorLayoutCache::init(VkDevice logicalDevice)
+	{
+		device = logicalDevice;
+	}
+
+	void MgeDescriptorLayoutCache::destroy()
+	{
+		for (auto& [key, layout] : layouts)
+		{
+			vkDestroyDescriptorSetLayout(device, layout, nullptr);
+		}
+
+		layouts.clear();
+	}
+
+	VkDescriptorSetLayout MgeDescriptorLayoutCache::getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings,
+		std::vector<VkDescriptorBindingFlags> bindingFlags)
+	{
+		if (!bindingFlags.empty() && bindingFlags.size() != bindings.size())
+		{
+			throw std::runtime_error("Descriptor binding flags do not match the bindings!");
+		}
+
+		// The same bindings listed in another order describe the same layout, the flags move with their binding
+		std::vector<size_t> order(bindings.size());
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+		LayoutKey key;
+
+		for (size_t i : order)
+		{
+			key.bindings.push_back(bindings[i]);
+
+			if (!bindingFlags.empty())
+			{
+				key.bindingFlags.push_back(bindingFlags[i]);
+			}
+		}
+
+		for (const auto& binding : key.bindings)
+		{
+			if (binding.pImmutableSamplers != nullptr)
+			{
+				throw std::runtime_error("Descriptor layout cache does not support immutable samplers!");
+			}
+		}
+
+		auto found = layouts.find(key);
+
+		if (found != layouts.end())
+		{
+			return found->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<unsigned int>(key.bindings.size());
+		layoutInfo.pBindings = key.bindings.data();
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+
+		if (!key.bindingFlags.empty())
+		{
+			bindingFlagsInfo.bindingCount = static_cast<unsigned int>(key.bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+
+			layoutInfo.pNext = &bindingFlagsInfo;
+
+			bool updateAfterBind = std::any_of(key.bindingFlags.begin(), key.bindingFlags.end(),
+				[](VkDescriptorBindingFlags flags) { return (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0; });
+
+			if (updateAfterBind)
+			{
+				layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			}
+		}
+
+		VkDescriptorSetLayout layout;
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout!");
+		}
+
+		layouts.emplace(std::move(key), layout);
+
+		return layout;
+	}
+
+	bool MgeDescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+	{
+		if (bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const auto& a = bindings[i];
+			const auto& b = other.bindings[i];
+
+			if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+				a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	size_t MgeDescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+	{
+		size_t hash = std::hash<size_t>()(key.bindings.size());
+
+		for (VkDescriptorBindingFlags flags : key.bindingFlags)
+		{
+			hash ^= std::hash<size_t>()(flags) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+
+		for (const auto& binding : key.bindings)
+		{
+			// Every field combined on its own, packing them into one size_t overflows on 32 bit builds
+			const size_t fields[] = { binding.binding, static_cast<size_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags };
+
+			for (size_t field : fields)
+			{
+				hash ^= std::hash<size_t>()(field) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+			}
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace mge {
+
+	/*
+	* Descriptor set layout cache
+	*
+	* Layouts are looked up by their bindings, so asking twice for the same bindings (in any order)
+	* returns the same VkDescriptorSetLayout. Pipelines built from identical set layouts then share
+	* them, and descriptor sets allocated for one are compatible with the other.
+	*
+	*     VkDescriptorSetLayout layout = layoutCache.getLayout({ cameraBinding });
+	*
+	* Binding flags (descriptor indexing) are part of the key. A layout with an UPDATE_AFTER_BIND
+	* binding is created with UPDATE_AFTER_BIND_POOL, its sets have to come from a pool created with
+	* VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT.
+	*
+	* The cache owns every layout it hands out, they are destroyed together in destroy().
+	* Immutable samplers are not supported.
+	*/
+	class MgeDescriptorLayoutCache
+	{
+	public:
+		void init(VkDevice logicalDevice);
+
+		void destroy();
+
+		// bindingFlags is either empty or holds one entry per binding, in the same order
+		VkDescriptorSetLayout getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings,
+			std::vector<VkDescriptorBindingFlags> bindingFlags = {});
+
+		size_t getLayoutCount() const { return layouts.size(); }
+
+	private:
+		struct LayoutKey
+		{
+			std::vector<VkDescriptorSetLayoutBinding> bindings;	// Sorted by binding number
+			std::vector<VkDescriptorBindingFlags> bindingFlags;	// Empty, or one per sorted binding
+
+			bool operator==(const LayoutKey& other) const;
+		};
+
+		struct LayoutKeyHash
+		{
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+	};
+}
@@ -0,0 +1,119 @@
+#include "FrameLimiter.h"
+
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+namespace mge {
+
+	MgeFrameLimiter::~MgeFrameLimiter()
+	{
+		setTimerResolution(false);
+	}
+
+	void MgeFrameLimiter::setFrameRate(double framesPerSecond)
+	{
+		period = std::chrono::duration<double, std::milli>(framesPerSecond > 0.0 ? 1000.0 / framesPerSecond : 0.0);
+		scheduled = false;
+
+		setTimerResolution(isEnabled());
+
+		// Sleeps measured at the old resolution say nothing about the new one
+		sleepCount = 0;
+		sleepMean = 0.0;
+		sleepM2 = 0.0;
+		sleepEstimate = 5.0;
+	}
+
+	void MgeFrameLimiter::setTimerResolution(bool raised)
+	{
+		if (raised == timerResolutionRaised)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		// Process wide, every timeBeginPeriod needs its matching timeEndPeriod
+		if (raised)
+		{
+			raised = timeBeginPeriod(1) == TIMERR_NOERROR;
+		}
+		else
+		{
+			timeEndPeriod(1);
+		}
+#endif
+
+		timerResolutionRaised = raised;
+	}
+
+	double MgeFrameLimiter::waitForNextFrame()
+	{
+		if (!isEnabled())
+		{
+			return 0.0;
+		}
+
+		if (!scheduled)
+		{
+			nextFrame = Clock::now();
+			scheduled = true;
+		}
+
+		waitUntil(nextFrame);
+
+		Clock::time_point now = Clock::now();
+		double error = std::chrono::duration<double, std::milli>(now - nextFrame).count();
+
+		nextFrame += std::chrono::duration_cast<Clock::duration>(period);
+
+		// More than a whole period behind, start over from here rather than catching up
+		if (nextFrame < now)
+		{
+			nextFrame = now + std::chrono::duration_cast<Clock::duration>(period);
+		}
+
+		return error;
+	}
+
+	void MgeFrameLimiter::waitUntil(Clock::time_point deadline)
+	{
+		while (std::chrono::duration<double, std::milli>(deadline - Clock::now()).count() > sleepEstimate)
+		{
+			Clock::time_point sleepStart = Clock::now();
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			addSleepSample(std::chrono::duration<double, std::milli>(Clock::now() - sleepStart).count());
+		}
+
+		while (Clock::now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void MgeFrameLimiter::addSleepSample(double milliseconds)
+	{
+		sleepCount++;
+
+		double delta = milliseconds - sleepMean;
+		sleepMean += delta / static_cast<double>(sleepCount);
+		sleepM2 += delta * (milliseconds - sleepMean);
+
+		if (sleepCount > 1)
+		{
+			sleepEstimate = sleepMean + std::sqrt(sleepM2 / static_cast<double>(sleepCount - 1));
+		}
+	}
+}
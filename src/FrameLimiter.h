@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+
+namespace mge {
+
+	/*
+	* Frame rate cap
+	*
+	* waitForNextFrame() is called once per frame, before any of its work, and returns once the frame
+	* is due. Frames are scheduled one period apart from the first one, so a frame that took a little
+	* longer does not push back all the ones after it. After a stall of more than a period (a resize, a
+	* present profile switch, ...) the schedule restarts instead of bursting frames to catch up.
+	*
+	* The wait sleeps while there is enough time left and spins on the rest. Sleeping is cheap but
+	* coarse (a 1 ms sleep can take anything up to a scheduler tick), so the limiter measures its own
+	* sleeps and only sleeps while more than the expected length of one sleep (mean plus one standard
+	* deviation) is left. Spinning yields the core between checks.
+	*
+	* On Windows the default timer resolution (about 15.6 ms) would leave almost the whole frame to the
+	* spin, so the limiter raises it to 1 ms with timeBeginPeriod for as long as a cap is set.
+	*/
+	class MgeFrameLimiter
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		MgeFrameLimiter() = default;
+
+		MgeFrameLimiter(const MgeFrameLimiter&) = delete;
+		MgeFrameLimiter& operator=(const MgeFrameLimiter&) = delete;
+
+		~MgeFrameLimiter();
+
+		// 0 removes the cap
+		void setFrameRate(double framesPerSecond);
+
+		bool isEnabled() const { return period.count() > 0.0; }
+
+		double getFrameRate() const { return isEnabled() ? 1000.0 / period.count() : 0.0; }
+
+		// Blocks until the frame is due, returns how late it returned in milliseconds (the pacing error)
+		double waitForNextFrame();
+
+	private:
+		std::chrono::duration<double, std::milli> period{ 0.0 };
+
+		bool scheduled = false;
+		bool timerResolutionRaised = false;
+		Clock::time_point nextFrame;
+
+		// Length of a 1 ms sleep as measured so far (Welford's running mean and variance)
+		unsigned long long sleepCount = 0;
+		double sleepMean = 0.0;
+		double sleepM2 = 0.0;
+		double sleepEstimate = 5.0;		// Conservative until a few sleeps have been measured
+
+		void waitUntil(Clock::time_point deadline);
+
+		void setTimerResolution(bool raised);
+
+		void addSleepSample(double milliseconds);
+	};
+}
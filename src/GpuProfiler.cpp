@@ -0,0 +1,233 @@
+#include "GpuProfiler.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeGpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, unsigned int queueFamilyIndex,
+		bool pipelineStatisticsSupported, unsigned int slotCount, unsigned int maxScopesPerSlot)
+	{
+		device = logicalDevice;
+		maxScopes = maxScopesPerSlot;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		unsigned int queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		unsigned int validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+
+		// A queue without valid timestamp bits can not be profiled, leave the profiler disabled
+		if (validBits == 0)
+		{
+			std::cerr << "GPU profiler : timestamps not supported on the graphics queue, profiling disabled" << std::endl;
+			return;
+		}
+
+		timestampPeriod = properties.limits.timestampPeriod;
+		timestampMask = validBits >= 64 ? ~0ULL : ((1ULL << validBits) - 1);
+
+		VkQueryPoolCreateInfo timestampInfo{};
+		timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		timestampInfo.queryCount = slotCount * maxScopes * 2;
+
+		if (vkCreateQueryPool(device, &timestampInfo, nullptr, &timestampPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+
+		if (pipelineStatisticsSupported)
+		{
+			VkQueryPoolCreateInfo statisticsInfo{};
+			statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			statisticsInfo.queryCount = slotCount * maxScopes;
+			statisticsInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+			if (vkCreateQueryPool(device, &statisticsInfo, nullptr, &statisticsPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create pipeline statistics query pool!");
+			}
+
+			statisticsFlags = statisticsInfo.pipelineStatistics;
+		}
+
+		slots.assign(slotCount, Slot{});
+	}
+
+	void MgeGpuProfiler::destroy()
+	{
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, statisticsPool, nullptr);
+			statisticsPool = VK_NULL_HANDLE;
+			statisticsFlags = 0;
+		}
+
+		if (timestampPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, timestampPool, nullptr);
+			timestampPool = VK_NULL_HANDLE;
+		}
+
+		slots.clear();
+		latestResults.clear();
+	}
+
+	void MgeGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, unsigned int slot)
+	{
+		if (!isEnabled() || slot >= slots.size())
+		{
+			return;
+		}
+
+		Slot& frame = slots[slot];
+		frame.scopeNames.clear();
+		frame.scopeHasStatistics.clear();
+		frame.openScopes.clear();
+		frame.statisticsActive = false;
+
+		vkCmdResetQueryPool(commandBuffer, timestampPool, firstTimestampQuery(slot), maxScopes * 2);
+
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, statisticsPool, firstStatisticsQuery(slot), maxScopes);
+		}
+	}
+
+	void MgeGpuProfiler::beginScope(VkCommandBuffer commandBuffer, unsigned int slot, const std::string& name, bool statistics)
+	{
+		if (!isEnabled() || slot >= slots.size() || slots[slot].scopeNames.size() >= maxScopes)
+		{
+			return;
+		}
+
+		Slot& frame = slots[slot];
+		unsigned int scope = static_cast<unsigned int>(frame.scopeNames.size());
+
+		statistics = statistics && statisticsPool != VK_NULL_HANDLE && !frame.statisticsActive;
+
+		frame.scopeNames.push_back(name);
+		frame.scopeHasStatistics.push_back(statistics);
+		frame.openScopes.push_back(scope);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, firstTimestampQuery(slot) + scope * 2);
+
+		if (statistics)
+		{
+			vkCmdBeginQuery(commandBuffer, statisticsPool, firstStatisticsQuery(slot) + scope, 0);
+			frame.statisticsActive = true;
+		}
+	}
+
+	void MgeGpuProfiler::endScope(VkCommandBuffer commandBuffer, unsigned int slot)
+	{
+		if (!isEnabled() || slot >= slots.size() || slots[slot].openScopes.empty())
+		{
+			return;
+		}
+
+		Slot& frame = slots[slot];
+		unsigned int scope = frame.openScopes.back();
+		frame.openScopes.pop_back();
+
+		if (frame.scopeHasStatistics[scope])
+		{
+			vkCmdEndQuery(commandBuffer, statisticsPool, firstStatisticsQuery(slot) + scope);
+			frame.statisticsActive = false;
+		}
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstTimestampQuery(slot) + scope * 2 + 1);
+	}
+
+	void MgeGpuProfiler::markSubmitted(unsigned int slot)
+	{
+		if (isEnabled() && slot < slots.size())
+		{
+			slots[slot].pending = true;
+		}
+	}
+
+	bool MgeGpuProfiler::collect(unsigned int slot)
+	{
+		if (!isEnabled() || slot >= slots.size() || !slots[slot].pending)
+		{
+			return false;
+		}
+
+		Slot& frame = slots[slot];
+		frame.pending = false;
+
+		unsigned int scopeCount = static_cast<unsigned int>(frame.scopeNames.size());
+
+		if (scopeCount == 0)
+		{
+			return false;
+		}
+
+		// Each query is followed by its availability word, no WAIT flag so this never blocks
+
+		std::vector<unsigned long long> timestamps(scopeCount * 2 * 2);
+
+		VkResult result = vkGetQueryPoolResults(device, timestampPool, firstTimestampQuery(slot), scopeCount * 2,
+			timestamps.size() * sizeof(unsigned long long), timestamps.data(), 2 * sizeof(unsigned long long),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			return false;
+		}
+
+		// vertex invocations, fragment invocations, availability
+		std::vector<unsigned long long> statistics;
+
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			statistics.resize(scopeCount * 3);
+
+			vkGetQueryPoolResults(device, statisticsPool, firstStatisticsQuery(slot), scopeCount,
+				statistics.size() * sizeof(unsigned long long), statistics.data(), 3 * sizeof(unsigned long long),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		}
+
+		std::vector<ScopeResult> results;
+		results.reserve(scopeCount);
+
+		for (unsigned int scope = 0; scope < scopeCount; scope++)
+		{
+			unsigned long long begin = timestamps[scope * 4 + 0];
+			unsigned long long beginAvailable = timestamps[scope * 4 + 1];
+			unsigned long long end = timestamps[scope * 4 + 2];
+			unsigned long long endAvailable = timestamps[scope * 4 + 3];
+
+			if (!beginAvailable || !endAvailable)
+			{
+				return false;
+			}
+
+			ScopeResult scopeResult{};
+			scopeResult.name = frame.scopeNames[scope];
+			scopeResult.gpuMilliseconds = static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1000000.0;
+
+			if (frame.scopeHasStatistics[scope] && statistics[scope * 3 + 2])
+			{
+				scopeResult.vertexInvocations = statistics[scope * 3 + 0];
+				scopeResult.fragmentInvocations = statistics[scope * 3 + 1];
+				scopeResult.hasStatistics = true;
+			}
+
+			results.push_back(scopeResult);
+		}
+
+		latestResults = std::move(results);
+
+		return true;
+	}
+}
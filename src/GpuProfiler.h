@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace mge {
+
+	/*
+	* GPU profiler built on timestamp and pipeline statistics query pools
+	*
+	* Work is measured in named scopes recorded into command buffers:
+	*
+	*     profiler.beginFrame(cmd, slot);               // outside any render pass
+	*     profiler.beginScope(cmd, slot, "main_pass");
+	*     ... render pass ...
+	*     profiler.endScope(cmd, slot);
+	*
+	* Every slot owns its own range of queries. The engine uses one slot per submission that can be
+	* in flight at the same time, and only calls collect(slot) once the frame timeline shows that slot's
+	* submission has finished, so the results are always available and reading them back never stalls the CPU.
+	*
+	* Pipeline statistics queries can not be nested, so only the outermost open scope gets vertex /
+	* fragment invocation counts. Nested scopes still get timestamps.
+	*/
+	class MgeGpuProfiler
+	{
+	public:
+		struct ScopeResult
+		{
+			std::string name;
+			double gpuMilliseconds = 0.0;
+			unsigned long long vertexInvocations = 0;
+			unsigned long long fragmentInvocations = 0;
+			bool hasStatistics = false;
+		};
+
+		void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, unsigned int queueFamilyIndex,
+			bool pipelineStatisticsSupported, unsigned int slotCount, unsigned int maxScopesPerSlot = 16);
+
+		void destroy();
+
+		bool isEnabled() const { return timestampPool != VK_NULL_HANDLE; }
+
+		// What the statistics queries count, 0 without pipeline statistics. Secondaries executed inside a scope inherit these.
+		VkQueryPipelineStatisticFlags getStatisticsFlags() const { return statisticsFlags; }
+
+		// Resets the slot's queries, must be recorded outside of a render pass
+		void beginFrame(VkCommandBuffer commandBuffer, unsigned int slot);
+
+		/*
+		* statistics = false keeps the scope to timestamps. Needed around vkCmdExecuteCommands when the
+		* secondaries can not inherit the statistics query (no inheritedQueries).
+		*/
+		void beginScope(VkCommandBuffer commandBuffer, unsigned int slot, const std::string& name, bool statistics = true);
+
+		void endScope(VkCommandBuffer commandBuffer, unsigned int slot);
+
+		// Call after a command buffer recorded against this slot was submitted
+		void markSubmitted(unsigned int slot);
+
+		// Reads back the slot's results. Only call once the slot's submission is known to be complete.
+		bool collect(unsigned int slot);
+
+		// Results of the most recently collected slot
+		const std::vector<ScopeResult>& getResults() const { return latestResults; }
+
+	private:
+		struct Slot
+		{
+			std::vector<std::string> scopeNames;
+			std::vector<bool> scopeHasStatistics;
+			std::vector<unsigned int> openScopes;
+			bool statisticsActive = false;
+			bool pending = false;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		VkQueryPipelineStatisticFlags statisticsFlags = 0;
+
+		double timestampPeriod = 1.0;	// nanoseconds per tick
+		unsigned long long timestampMask = ~0ULL;
+
+		unsigned int maxScopes = 0;
+
+		std::vector<Slot> slots;
+		std::vector<ScopeResult> latestResults;
+
+		unsigned int firstTimestampQuery(unsigned int slot) const { return slot * maxScopes * 2; }
+		unsigned int firstStatisticsQuery(unsigned int slot) const { return slot * maxScopes; }
+	};
+}
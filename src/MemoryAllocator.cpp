@@ -0,0 +1,415 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeAllocator::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize preferredBlockSize)
+	{
+		device = logicalDevice;
+
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		// Blocks are split with a buddy allocator, so they have to be a power of two
+		blockSize = 1ull << orderOf(preferredBlockSize);
+
+		stats = Stats{};
+	}
+
+	void MgeAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				if (block.memory != VK_NULL_HANDLE)
+				{
+					vkFreeMemory(device, block.memory, nullptr);
+				}
+			}
+		}
+
+		pools.clear();
+		stats = Stats{};
+	}
+
+	unsigned int MgeAllocator::findMemoryType(unsigned int typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (unsigned int i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Failed to find suitable memory type!");
+	}
+
+	MgeAllocation MgeAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MgeResourceKind kind)
+	{
+		unsigned int memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+		// A buddy node of 2^order bytes is aligned to 2^order, so cover both size and alignment
+		unsigned int order = std::max(orderOf(requirements.size), orderOf(requirements.alignment));
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		unsigned int poolIndex = getPool(memoryType, kind);
+		Pool& pool = pools[poolIndex];
+
+		// More than half a block would waste most of it, give it its own memory instead
+		if (order >= pool.blockOrder)
+		{
+			lock.unlock();
+
+			return allocateDedicated(requirements, properties);
+		}
+
+		MgeAllocation allocation{};
+		allocation.poolIndex = poolIndex;
+		allocation.order = order;
+
+		unsigned int blockIndex = static_cast<unsigned int>(pool.blocks.size());
+
+		for (unsigned int i = 0; i < pool.blocks.size(); i++)
+		{
+			if (pool.blocks[i].memory != VK_NULL_HANDLE && allocateFromBlock(pool, pool.blocks[i], order, allocation.offset))
+			{
+				blockIndex = i;
+				break;
+			}
+		}
+
+		// No room in any block, reserve a new one (reusing a released slot if there is one)
+		if (blockIndex == pool.blocks.size())
+		{
+			for (unsigned int i = 0; i < pool.blocks.size(); i++)
+			{
+				if (pool.blocks[i].memory == VK_NULL_HANDLE)
+				{
+					blockIndex = i;
+					break;
+				}
+			}
+
+			if (blockIndex == pool.blocks.size())
+			{
+				pool.blocks.emplace_back();
+			}
+
+			Block& block = pool.blocks[blockIndex];
+			VkDeviceSize poolBlockSize = 1ull << pool.blockOrder;
+
+			block.memory = allocateMemory(poolBlockSize, memoryType, &block.mapped, nullptr);
+			block.usedBytes = 0;
+			block.freeLists.assign(pool.blockOrder + 1, {});
+			block.freeLists[pool.blockOrder].insert(0);
+
+			stats.reservedBytes += poolBlockSize;
+			stats.blockCount++;
+
+			allocateFromBlock(pool, block, order, allocation.offset);
+		}
+
+		Block& block = pool.blocks[blockIndex];
+
+		allocation.memory = block.memory;
+		allocation.size = requirements.size;
+		allocation.blockIndex = blockIndex;
+		allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+
+		stats.usedBytes += 1ull << order;
+		stats.allocationCount++;
+
+		return allocation;
+	}
+
+	MgeAllocation MgeAllocator::allocateDedicated(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		VkBuffer buffer, VkImage image)
+	{
+		unsigned int memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = buffer;
+		dedicatedInfo.image = image;
+
+		bool hasResource = buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE;
+
+		MgeAllocation allocation{};
+		allocation.dedicated = true;
+		allocation.size = requirements.size;
+		allocation.memory = allocateMemory(requirements.size, memoryType, &allocation.mapped, hasResource ? &dedicatedInfo : nullptr);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		stats.usedBytes += requirements.size;
+		stats.reservedBytes += requirements.size;
+		stats.dedicatedCount++;
+		stats.allocationCount++;
+
+		return allocation;
+	}
+
+	void MgeAllocator::free(MgeAllocation& allocation)
+	{
+		if (!allocation.isValid())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (allocation.dedicated)
+		{
+			// Freeing mapped memory unmaps it implicitly
+			vkFreeMemory(device, allocation.memory, nullptr);
+
+			stats.usedBytes -= allocation.size;
+			stats.reservedBytes -= allocation.size;
+			stats.dedicatedCount--;
+		}
+		else
+		{
+			Pool& pool = pools[allocation.poolIndex];
+			Block& block = pool.blocks[allocation.blockIndex];
+
+			freeToBlock(block, allocation.offset, allocation.order);
+
+			stats.usedBytes -= 1ull << allocation.order;
+
+			// Give an empty block back to the driver, but keep the last one to avoid churn
+			unsigned int liveBlocks = static_cast<unsigned int>(std::count_if(pool.blocks.begin(), pool.blocks.end(),
+				[](const Block& b) { return b.memory != VK_NULL_HANDLE; }));
+
+			if (block.usedBytes == 0 && liveBlocks > 1)
+			{
+				vkFreeMemory(device, block.memory, nullptr);
+
+				block.memory = VK_NULL_HANDLE;
+				block.mapped = nullptr;
+				block.freeLists.clear();
+
+				stats.reservedBytes -= 1ull << pool.blockOrder;
+				stats.blockCount--;
+			}
+		}
+
+		stats.allocationCount--;
+
+		allocation = MgeAllocation{};
+	}
+
+	void MgeAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		VkBuffer& buffer, MgeAllocation& allocation)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create buffer");
+		}
+
+		// Ask the driver whether it wants this buffer in its own allocation
+		VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.buffer = buffer;
+
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+
+		vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+		if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation)
+		{
+			allocation = allocateDedicated(requirements.memoryRequirements, properties, buffer);
+		}
+		else
+		{
+			allocation = allocate(requirements.memoryRequirements, properties, MgeResourceKind::Linear);
+		}
+
+		vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+	}
+
+	void MgeAllocator::destroyBuffer(VkBuffer& buffer, MgeAllocation& allocation)
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+
+		free(allocation);
+	}
+
+	void MgeAllocator::bindImage(VkImage image, VkMemoryPropertyFlags properties, MgeAllocation& allocation)
+	{
+		VkImageMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.image = image;
+
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+
+		vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+		// Render targets usually prefer dedicated memory, most drivers compress them better that way
+		if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation)
+		{
+			allocation = allocateDedicated(requirements.memoryRequirements, properties, VK_NULL_HANDLE, image);
+		}
+		else
+		{
+			allocation = allocate(requirements.memoryRequirements, properties, MgeResourceKind::Optimal);
+		}
+
+		vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+	}
+
+	MgeAllocator::Stats MgeAllocator::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return stats;
+	}
+
+	VkDeviceMemory MgeAllocator::allocateMemory(VkDeviceSize size, unsigned int memoryType, void** mapped, const void* next)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext = next;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		VkDeviceMemory memory;
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate device memory!");
+		}
+
+		*mapped = nullptr;
+
+		// Host visible memory stays mapped for its whole lifetime
+		if (isHostVisible(memoryType) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+		{
+			vkFreeMemory(device, memory, nullptr);
+
+			throw std::runtime_error("Failed to map device memory!");
+		}
+
+		return memory;
+	}
+
+	unsigned int MgeAllocator::getPool(unsigned int memoryType, MgeResourceKind kind)
+	{
+		for (unsigned int i = 0; i < pools.size(); i++)
+		{
+			if (pools[i].memoryType == memoryType && pools[i].kind == kind)
+			{
+				return i;
+			}
+		}
+
+		Pool pool{};
+		pool.memoryType = memoryType;
+		pool.kind = kind;
+		pool.blockOrder = orderOf(blockSize);
+
+		// Small heaps (e.g. the 256 MiB device local + host visible BAR heap) get smaller blocks
+		VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+
+		while (pool.blockOrder > MIN_ORDER + 4 && (1ull << pool.blockOrder) > heapSize / 8)
+		{
+			pool.blockOrder--;
+		}
+
+		pools.push_back(pool);
+
+		return static_cast<unsigned int>(pools.size() - 1);
+	}
+
+	bool MgeAllocator::allocateFromBlock(Pool& pool, Block& block, unsigned int order, VkDeviceSize& offset)
+	{
+		// Smallest free node that fits
+		unsigned int freeOrder = order;
+
+		while (freeOrder <= pool.blockOrder && block.freeLists[freeOrder].empty())
+		{
+			freeOrder++;
+		}
+
+		if (freeOrder > pool.blockOrder)
+		{
+			return false;
+		}
+
+		offset = *block.freeLists[freeOrder].begin();
+		block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+
+		// Split it down, the upper halves go back on the free lists
+		while (freeOrder > order)
+		{
+			freeOrder--;
+			block.freeLists[freeOrder].insert(offset + (1ull << freeOrder));
+		}
+
+		block.usedBytes += 1ull << order;
+
+		return true;
+	}
+
+	void MgeAllocator::freeToBlock(Block& block, VkDeviceSize offset, unsigned int order)
+	{
+		block.usedBytes -= 1ull << order;
+
+		unsigned int blockOrder = static_cast<unsigned int>(block.freeLists.size() - 1);
+
+		// Merge with the buddy for as long as it is free as well
+		while (order < blockOrder)
+		{
+			VkDeviceSize buddy = offset ^ (1ull << order);
+
+			if (block.freeLists[order].erase(buddy) == 0)
+			{
+				break;
+			}
+
+			offset = std::min(offset, buddy);
+			order++;
+		}
+
+		block.freeLists[order].insert(offset);
+	}
+
+	bool MgeAllocator::isHostVisible(unsigned int memoryType) const
+	{
+		return (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	unsigned int MgeAllocator::orderOf(VkDeviceSize size)
+	{
+		unsigned int order = MIN_ORDER;
+
+		while ((1ull << order) < size)
+		{
+			order++;
+		}
+
+		return order;
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace mge {
+
+	/*
+	* What a block of memory is bound to. Buffers and linear images may not share a page with
+	* optimally tiled images (bufferImageGranularity), so the two kinds never share a block.
+	*/
+	enum class MgeResourceKind
+	{
+		Linear,
+		Optimal
+	};
+
+	/*
+	* A range of device memory handed out by MgeAllocator. Bind the resource with memory + offset.
+	* Allocations from host-visible memory are persistently mapped, mapped points at offset.
+	*/
+	struct MgeAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+
+		// Bookkeeping for MgeAllocator::free
+		unsigned int poolIndex = 0;
+		unsigned int blockIndex = 0;
+		unsigned int order = 0;
+		bool dedicated = false;
+
+		bool isValid() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	/*
+	* Block based device memory allocator
+	*
+	* Drivers only allow a few thousand vkAllocateMemory calls (maxMemoryAllocationCount, often
+	* 4096) and every call is slow, so memory is reserved in large blocks and resources are
+	* sub-allocated from them.
+	*
+	* There is one pool per (memory type, resource kind). Each block is a power of two in size and is
+	* split with a buddy allocator. A node of 2^k bytes always starts at a multiple of 2^k, so
+	* alignment only means picking a node at least as large as the alignment. Freed nodes merge with
+	* their buddy again.
+	*
+	* Resources larger than half a block, or whose driver prefers it, get a dedicated allocation.
+	*/
+	class MgeAllocator
+	{
+	public:
+		struct Stats
+		{
+			VkDeviceSize usedBytes = 0;			// Handed out to resources (after rounding up to buddy sizes)
+			VkDeviceSize reservedBytes = 0;		// Allocated from the driver, blocks + dedicated
+			unsigned int blockCount = 0;
+			unsigned int dedicatedCount = 0;
+			unsigned int allocationCount = 0;	// Live sub-allocations and dedicated allocations
+		};
+
+		void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024);
+
+		void destroy();
+
+		// Memory properties are queried once in init(), this is just a lookup
+		unsigned int findMemoryType(unsigned int typeFilter, VkMemoryPropertyFlags properties) const;
+
+		MgeAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MgeResourceKind kind);
+
+		// Own VkDeviceMemory for a single resource. Pass the buffer or image to use VK_KHR_dedicated_allocation (core in 1.1).
+		MgeAllocation allocateDedicated(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+			VkBuffer buffer = VK_NULL_HANDLE, VkImage image = VK_NULL_HANDLE);
+
+		void free(MgeAllocation& allocation);
+
+		// Creates the buffer, allocates and binds its memory
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+			VkBuffer& buffer, MgeAllocation& allocation);
+
+		void destroyBuffer(VkBuffer& buffer, MgeAllocation& allocation);
+
+		// Allocates and binds memory for an image created by the caller
+		void bindImage(VkImage image, VkMemoryPropertyFlags properties, MgeAllocation& allocation);
+
+		Stats getStats() const;
+
+	private:
+		static const unsigned int MIN_ORDER = 8;	// Smallest node, 256 bytes
+
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+			VkDeviceSize usedBytes = 0;
+
+			std::vector<std::set<VkDeviceSize>> freeLists;	// Free node offsets per order
+		};
+
+		struct Pool
+		{
+			unsigned int memoryType = 0;
+			MgeResourceKind kind = MgeResourceKind::Linear;
+			unsigned int blockOrder = 0;
+
+			std::vector<Block> blocks;	// Released blocks keep their slot (memory == VK_NULL_HANDLE)
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+		VkDeviceSize blockSize = 0;
+
+		std::vector<Pool> pools;
+
+		Stats stats;
+
+		mutable std::mutex mutex;
+
+		VkDeviceMemory allocateMemory(VkDeviceSize size, unsigned int memoryType, void** mapped, const void* next);
+
+		unsigned int getPool(unsigned int memoryType, MgeResourceKind kind);
+
+		bool allocateFromBlock(Pool& pool, Block& block, unsigned int order, VkDeviceSize& offset);
+
+		void freeToBlock(Block& block, VkDeviceSize offset, unsigned int order);
+
+		bool isHostVisible(unsigned int memoryType) const;
+
+		static unsigned int orderOf(VkDeviceSize size);
+	};
+}
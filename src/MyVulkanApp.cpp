@@ -9,10 +9,275 @@
  const uint32_t HEIGHT = 900;
  std::string windowName = { "My First App" };
 
-int main() {
+ // Frames rendered by a headless run when --frames is not given
+ const unsigned long long DEFAULT_HEADLESS_FRAMES = 1000;
+
+/*
+* Command line options
+*
+*   --headless      render offscreen without a window (no display needed)
+*   --frames <n>    stop after n frames
+*   --present-mode <fifo|fifo_relaxed|mailbox|immediate>
+*   --present-profile <default|low_latency|throughput>  frames in flight / present mode / image count policy
+*   --benchmark <n>  time n frames, print min/avg/p50/p95/p99/max and write a JSON report
+*   --warmup <n>     untimed frames before the benchmark starts (default 100)
+*   --report <file>  benchmark report file (default benchmark.json)
+*   --recording <prerecorded|perframe>  how draw command buffers are produced (default perframe)
+*   --render-backend <renderpass|dynamic>  render pass + framebuffers, or dynamic rendering (default renderpass)
+*   --render-scale <s>  draw the scene at s times the window size and blit it to the swapchain (dynamic backend)
+*   --threads <n>    record the draw list on n worker threads into secondary command buffers
+*   --draws <n>      draws in the draw list (default 1)
+*   --thread-scaling benchmark recording with 1 .. n threads (n = --threads, or all hardware threads)
+*   --instances <n>  draw the quad n times from a per-instance vertex buffer (split over --draws draw calls)
+*   --instance-stress benchmark the instanced path with 100k .. 1M instances
+*   --gpu-culling    cull the instances in a compute pass and draw the visible ones with one indirect draw
+*   --no-transfer-queue  upload on the graphics queue even when a dedicated transfer queue exists
+*   --packed-vertices    half float positions and 8 bit colors in the vertex buffer
+*   --textures <n>   stream n procedural textures in the background and spread them over the draws
+*   --texture-budget-mb <n>  device memory the streamed textures may hold (default 256)
+*   --fps-cap <n>    cap the frame rate at n frames per second (default 0 = uncapped)
+*   --on-demand      only draw when input, a resize, the camera or a texture changed something
+*/
+VkPresentModeKHR parsePresentMode(const std::string& name)
+{
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo_relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+    throw std::runtime_error("Unknown present mode : " + name);
+}
+
+mge::MgePresentProfile parsePresentProfile(const std::string& name)
+{
+    if (name == "default") return mge::MgePresentProfile::Default;
+    if (name == "low_latency") return mge::MgePresentProfile::LowLatency;
+    if (name == "throughput") return mge::MgePresentProfile::Throughput;
+
+    throw std::runtime_error("Unknown present profile : " + name);
+}
+
+mge::MgeCommandRecording parseCommandRecording(const std::string& name)
+{
+    if (name == "prerecorded") return mge::MgeCommandRecording::PreRecorded;
+    if (name == "perframe") return mge::MgeCommandRecording::PerFrame;
+
+    throw std::runtime_error("Unknown command recording mode : " + name);
+}
+
+mge::MgeRenderBackend parseRenderBackend(const std::string& name)
+{
+    if (name == "renderpass") return mge::MgeRenderBackend::RenderPass;
+    if (name == "dynamic") return mge::MgeRenderBackend::Dynamic;
+
+    throw std::runtime_error("Unknown render backend : " + name);
+}
+
+mge::MgeEngineConfig parseCommandLine(int argc, char* argv[])
+{
+    mge::MgeEngineConfig config{};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--headless")
+        {
+            config.headless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            config.frameCount = std::stoull(argv[++i]);
+        }
+        else if (arg == "--present-mode" && i + 1 < argc)
+        {
+            config.preferredPresentMode = parsePresentMode(argv[++i]);
+        }
+        else if (arg == "--present-profile" && i + 1 < argc)
+        {
+            config.presentProfile = parsePresentProfile(argv[++i]);
+        }
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            config.benchmarkFrames = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            config.benchmarkWarmupFrames = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            config.benchmarkReport = argv[++i];
+        }
+        else if (arg == "--recording" && i + 1 < argc)
+        {
+            config.commandRecording = parseCommandRecording(argv[++i]);
+        }
+        else if (arg == "--render-backend" && i + 1 < argc)
+        {
+            config.renderBackend = parseRenderBackend(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            config.recordingThreads = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--draws" && i + 1 < argc)
+        {
+            config.drawCount = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--thread-scaling")
+        {
+            config.threadScaling = true;
+        }
+        else if (arg == "--instances" && i + 1 < argc)
+        {
+            config.instanceCount = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--instance-stress")
+        {
+            config.instanceStress = true;
+        }
+        else if (arg == "--gpu-culling")
+        {
+            config.gpuCulling = true;
+        }
+        else if (arg == "--no-transfer-queue")
+        {
+            config.useTransferQueue = false;
+        }
+        else if (arg == "--packed-vertices")
+        {
+            config.packedVertices = true;
+        }
+        else if (arg == "--textures" && i + 1 < argc)
+        {
+            config.textureCount = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--texture-budget-mb" && i + 1 < argc)
+        {
+            config.textureBudget = std::stoull(argv[++i]) * 1024 * 1024;
+        }
+        else if (arg == "--render-scale" && i + 1 < argc)
+        {
+            config.renderScale = std::stof(argv[++i]);
+        }
+        else if (arg == "--fps-cap" && i + 1 < argc)
+        {
+            config.frameRateCap = std::stod(argv[++i]);
+        }
+        else if (arg == "--on-demand")
+        {
+            config.renderOnDemand = true;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown command line option : " + arg);
+        }
+    }
+
+    // Worker threads record the per-frame command buffers, pre-recorded buffers are only recorded once
+    if ((config.recordingThreads > 0 || config.threadScaling) && config.commandRecording == mge::MgeCommandRecording::PreRecorded)
+    {
+        throw std::runtime_error("--threads and --thread-scaling need --recording perframe");
+    }
+
+    if (config.threadScaling && config.benchmarkFrames == 0)
+    {
+        throw std::runtime_error("--thread-scaling needs --benchmark <n>");
+    }
+
+    if (config.instanceStress && config.benchmarkFrames == 0)
+    {
+        throw std::runtime_error("--instance-stress needs --benchmark <n>");
+    }
+
+    // The instance buffer is the object list the cull pass works on
+    if (config.gpuCulling && config.instanceCount == 0 && !config.instanceStress)
+    {
+        throw std::runtime_error("--gpu-culling needs --instances <n> or --instance-stress");
+    }
+
+    // The report is only written once every timed frame has run
+    if (config.benchmarkFrames > 0 && config.frameCount > 0)
+    {
+        if (config.threadScaling || config.instanceStress)
+        {
+            throw std::runtime_error("--frames can not be combined with --thread-scaling or --instance-stress");
+        }
+
+        if (config.frameCount < static_cast<unsigned long long>(config.benchmarkWarmupFrames) + config.benchmarkFrames)
+        {
+            throw std::runtime_error("--frames has to cover the --warmup and --benchmark frames");
+        }
+    }
+
+    if (config.instanceStress && config.threadScaling)
+    {
+        throw std::runtime_error("--instance-stress and --thread-scaling can not be combined");
+    }
+
+    // Texture handles change as textures stream, only command buffers recorded every frame follow them
+    if (config.textureCount > 0 && config.commandRecording == mge::MgeCommandRecording::PreRecorded)
+    {
+        throw std::runtime_error("--textures needs --recording perframe");
+    }
+
+    if (config.textureCount > 0 && (config.instanceCount > 0 || config.instanceStress))
+    {
+        throw std::runtime_error("--textures can not be combined with the instanced path");
+    }
+
+    if (config.renderScale <= 0.0f)
+    {
+        throw std::runtime_error("--render-scale needs a scale above 0");
+    }
+
+    if (config.frameRateCap < 0.0)
+    {
+        throw std::runtime_error("--fps-cap needs a frame rate of 0 (uncapped) or above");
+    }
+
+    // Idle waits are glfwWaitEvents on the window, a benchmark needs frames drawn back to back
+    if (config.renderOnDemand && config.headless)
+    {
+        throw std::runtime_error("--on-demand needs a window, it can not be combined with --headless");
+    }
+
+    if (config.renderOnDemand && config.benchmarkFrames > 0)
+    {
+        throw std::runtime_error("--on-demand can not be combined with --benchmark");
+    }
+
+    // The scene target is a render graph transient, there are no framebuffers for it
+    if (config.renderScale != 1.0f && config.renderBackend != mge::MgeRenderBackend::Dynamic)
+    {
+        throw std::runtime_error("--render-scale needs --render-backend dynamic");
+    }
+
+    // A benchmark ends the run on its own once the timed frames are done
+    if (config.headless && config.frameCount == 0 && config.benchmarkFrames == 0)
+    {
+        config.frameCount = DEFAULT_HEADLESS_FRAMES;
+    }
+
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+
+    mge::MgeEngineConfig config{};
+
+    try {
+        config = parseCommandLine(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+
+        return EXIT_FAILURE;
+    }
 
     //mge::FirstApp app{};
-    mge::MgeEngine mainWindow{ WIDTH, HEIGHT, windowName };
+    mge::MgeEngine mainWindow{ WIDTH, HEIGHT, windowName, config };
 
     try {
         mainWindow.run();
@@ -20,7 +285,10 @@ int main() {
     catch (const std::exception& e) {
         std::cerr << e.what() << "\n";
 
-        system("pause");
+        // Nobody is there to press a key on a headless machine
+        if (!config.headless) {
+            system("pause");
+        }
 
         return EXIT_FAILURE;
     }
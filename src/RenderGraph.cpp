@@ -0,0 +1,698 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mge {
+
+	MgeRenderGraph::PassBuilder& MgeRenderGraph::PassBuilder::read(MgeRenderResource resource, VkPipelineStageFlags2 stages,
+		VkAccessFlags2 access, VkImageLayout layout)
+	{
+		graph.addAccess(pass, resource, stages, access, layout, false);
+
+		return *this;
+	}
+
+	MgeRenderGraph::PassBuilder& MgeRenderGraph::PassBuilder::write(MgeRenderResource resource, VkPipelineStageFlags2 stages,
+		VkAccessFlags2 access, VkImageLayout layout)
+	{
+		graph.addAccess(pass, resource, stages, access, layout, true);
+
+		return *this;
+	}
+
+	void MgeRenderGraph::init(VkDevice logicalDevice, MgeAllocator& memoryAllocator)
+	{
+		device = logicalDevice;
+		allocator = &memoryAllocator;
+	}
+
+	void MgeRenderGraph::destroy()
+	{
+		for (auto& transient : transients)
+		{
+			vkDestroyImageView(device, transient.imageView, nullptr);
+			vkDestroyImage(device, transient.image, nullptr);
+		}
+
+		for (auto& slot : slots)
+		{
+			allocator->free(slot.allocation);
+		}
+
+		transients.clear();
+		slots.clear();
+
+		reset();
+	}
+
+	void MgeRenderGraph::reset()
+	{
+		resources.clear();
+		passes.clear();
+		finalImageBarriers.clear();
+	}
+
+	MgeRenderResource MgeRenderGraph::importImage(const std::string& name, VkImage image, VkImageView imageView,
+		VkImageLayout initialLayout, VkPipelineStageFlags2 initialStages, VkImageLayout finalLayout)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.imported = true;
+		resource.image = image;
+		resource.imageView = imageView;
+		resource.initialLayout = initialLayout;
+		resource.initialStages = initialStages;
+		resource.finalLayout = finalLayout;
+
+		resources.push_back(resource);
+
+		return static_cast<MgeRenderResource>(resources.size() - 1);
+	}
+
+	MgeRenderResource MgeRenderGraph::importBuffer(const std::string& name, VkBuffer buffer,
+		VkPipelineStageFlags2 initialStages, VkAccessFlags2 initialAccess)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.imported = true;
+		resource.buffer = buffer;
+		resource.initialStages = initialStages;
+		resource.initialAccess = initialAccess;
+
+		resources.push_back(resource);
+
+		return static_cast<MgeRenderResource>(resources.size() - 1);
+	}
+
+	MgeRenderResource MgeRenderGraph::createImage(const std::string& name, const MgeTransientImageDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.desc = desc;
+
+		resources.push_back(resource);
+
+		return static_cast<MgeRenderResource>(resources.size() - 1);
+	}
+
+	MgeRenderGraph::PassBuilder MgeRenderGraph::addPass(const std::string& name, Execute execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+
+		passes.push_back(std::move(pass));
+
+		return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+	}
+
+	void MgeRenderGraph::markOutput(MgeRenderResource resource)
+	{
+		resources[resource].output = true;
+	}
+
+	void MgeRenderGraph::addAccess(uint32_t pass, MgeRenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+		VkImageLayout layout, bool write)
+	{
+		if (resources[resource].isImage && layout == VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			throw std::runtime_error("Render graph image " + resources[resource].name + " is accessed without a layout!");
+		}
+
+		std::vector<Access>& accesses = passes[pass].accesses;
+
+		auto found = std::find_if(accesses.begin(), accesses.end(), [&](const Access& other) { return other.resource == resource; });
+
+		if (found == accesses.end())
+		{
+			Access newAccess;
+			newAccess.resource = resource;
+			newAccess.layout = layout;
+
+			accesses.push_back(newAccess);
+			found = accesses.end() - 1;
+		}
+		else if (found->layout != layout)
+		{
+			// One barrier per resource and pass, so a pass sees an image in one layout only
+			throw std::runtime_error("Render graph pass " + passes[pass].name + " uses " + resources[resource].name + " in two layouts!");
+		}
+
+		if (write)
+		{
+			found->write = true;
+			found->writeStages |= stages;
+			found->writeAccess |= access;
+		}
+		else
+		{
+			found->read = true;
+			found->readStages |= stages;
+			found->readAccess |= access;
+		}
+	}
+
+	const MgeRenderGraph::Access& MgeRenderGraph::findAccess(uint32_t pass, MgeRenderResource resource) const
+	{
+		const std::vector<Access>& accesses = passes[pass].accesses;
+
+		return *std::find_if(accesses.begin(), accesses.end(), [&](const Access& access) { return access.resource == resource; });
+	}
+
+	void MgeRenderGraph::compile(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission)
+	{
+		stats = Stats{};
+		stats.passCount = static_cast<uint32_t>(passes.size());
+
+		cullPasses();
+
+		allocateTransients(deletionQueue, lastSubmission);
+
+		buildBarriers();
+	}
+
+	void MgeRenderGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		for (auto& pass : passes)
+		{
+			if (pass.culled)
+			{
+				continue;
+			}
+
+			recordBarriers(commandBuffer, pass.imageBarriers, pass.bufferBarriers);
+
+			pass.execute(commandBuffer);
+		}
+
+		recordBarriers(commandBuffer, finalImageBarriers, {});
+	}
+
+	VkImage MgeRenderGraph::getImage(MgeRenderResource resource) const
+	{
+		const Resource& image = resources[resource];
+
+		return image.imported ? image.image : transients[image.transient].image;
+	}
+
+	VkImageView MgeRenderGraph::getImageView(MgeRenderResource resource) const
+	{
+		const Resource& image = resources[resource];
+
+		return image.imported ? image.imageView : transients[image.transient].imageView;
+	}
+
+	VkBuffer MgeRenderGraph::getBuffer(MgeRenderResource resource) const
+	{
+		return resources[resource].buffer;
+	}
+
+	/*
+	* Culling
+	*
+	* Walking backwards from the last pass, a pass is needed when it writes a resource that is an
+	* output or is read by a pass that is needed. The resources a needed pass reads become needed in
+	* turn. Writes are never assumed to overwrite everything, so an earlier writer of a needed
+	* resource is kept too.
+	*/
+	void MgeRenderGraph::cullPasses()
+	{
+		std::vector<bool> needed(resources.size());
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			needed[i] = resources[i].output;
+		}
+
+		for (size_t i = passes.size(); i-- > 0;)
+		{
+			Pass& pass = passes[i];
+
+			pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(),
+				[&](const Access& access) { return access.write && needed[access.resource]; });
+
+			if (pass.culled)
+			{
+				stats.culledPassCount++;
+				continue;
+			}
+
+			for (const auto& access : pass.accesses)
+			{
+				if (access.read)
+				{
+					needed[access.resource] = true;
+				}
+			}
+		}
+
+		// Lifetimes only count the passes that are kept
+		for (uint32_t i = 0; i < passes.size(); i++)
+		{
+			if (passes[i].culled)
+			{
+				continue;
+			}
+
+			for (const auto& access : passes[i].accesses)
+			{
+				Resource& resource = resources[access.resource];
+
+				if (resource.firstPass == NO_PASS)
+				{
+					resource.firstPass = i;
+				}
+
+				resource.lastPass = i;
+			}
+		}
+	}
+
+	/*
+	* Transient images and aliasing
+	*
+	* Transients are placed in order of their first pass. Each goes into the first memory slot whose
+	* current occupant's last pass comes before its own first pass, the slot growing to the largest
+	* size and alignment among its occupants. A transient that fits nowhere opens a new slot. Every
+	* slot is one allocation, all of its occupants are bound at the same offset.
+	*/
+	void MgeRenderGraph::allocateTransients(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission)
+	{
+		std::vector<MgeRenderResource> used;
+
+		for (MgeRenderResource i = 0; i < resources.size(); i++)
+		{
+			if (!resources[i].imported && resources[i].firstPass != NO_PASS)
+			{
+				used.push_back(i);
+			}
+		}
+
+		// Same transients with the same lifetimes as last time, the cached images still fit
+		bool cached = used.size() == transients.size();
+
+		for (size_t i = 0; cached && i < used.size(); i++)
+		{
+			const Resource& resource = resources[used[i]];
+
+			cached = resource.desc == transients[i].desc && resource.firstPass == transients[i].firstPass &&
+				resource.lastPass == transients[i].lastPass;
+		}
+
+		if (!cached)
+		{
+			retireTransients(deletionQueue, lastSubmission);
+
+			for (MgeRenderResource index : used)
+			{
+				const Resource& resource = resources[index];
+
+				TransientImage transient;
+				transient.desc = resource.desc;
+				transient.firstPass = resource.firstPass;
+				transient.lastPass = resource.lastPass;
+
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.format = resource.desc.format;
+				imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.usage = resource.desc.usage;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+				if (vkCreateImage(device, &imageInfo, nullptr, &transient.image) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create transient image " + resource.name + "!");
+				}
+
+				VkImageMemoryRequirementsInfo2 requirementsInfo{};
+				requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+				requirementsInfo.image = transient.image;
+
+				VkMemoryDedicatedRequirements dedicatedRequirements{};
+				dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+				VkMemoryRequirements2 requirements{};
+				requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+				requirements.pNext = &dedicatedRequirements;
+
+				vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+				// A preference for dedicated memory loses against aliasing, a requirement does not
+				transient.requirements = requirements.memoryRequirements;
+				transient.dedicated = dedicatedRequirements.requiresDedicatedAllocation == VK_TRUE;
+
+				transients.push_back(transient);
+			}
+
+			std::vector<uint32_t> order(transients.size());
+
+			for (uint32_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+
+			std::stable_sort(order.begin(), order.end(),
+				[&](uint32_t a, uint32_t b) { return transients[a].firstPass < transients[b].firstPass; });
+
+			for (uint32_t index : order)
+			{
+				TransientImage& transient = transients[index];
+
+				auto fits = [&](const MemorySlot& slot)
+				{
+					return !slot.dedicated && !transient.dedicated &&
+						transients[slot.occupants.back()].lastPass < transient.firstPass &&
+						(slot.requirements.memoryTypeBits & transient.requirements.memoryTypeBits) != 0;
+				};
+
+				auto slot = std::find_if(slots.begin(), slots.end(), fits);
+
+				if (slot == slots.end())
+				{
+					MemorySlot newSlot;
+					newSlot.requirements = transient.requirements;
+					newSlot.dedicated = transient.dedicated;
+
+					slots.push_back(newSlot);
+					slot = slots.end() - 1;
+				}
+				else
+				{
+					slot->requirements.size = std::max(slot->requirements.size, transient.requirements.size);
+					slot->requirements.alignment = std::max(slot->requirements.alignment, transient.requirements.alignment);
+					slot->requirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+				}
+
+				transient.slot = static_cast<uint32_t>(slot - slots.begin());
+				slot->occupants.push_back(index);
+			}
+
+			for (auto& slot : slots)
+			{
+				if (slot.dedicated)
+				{
+					slot.allocation = allocator->allocateDedicated(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						VK_NULL_HANDLE, transients[slot.occupants.front()].image);
+				}
+				else
+				{
+					slot.allocation = allocator->allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MgeResourceKind::Optimal);
+				}
+
+				for (uint32_t occupant : slot.occupants)
+				{
+					TransientImage& transient = transients[occupant];
+
+					vkBindImageMemory(device, transient.image, slot.allocation.memory, slot.allocation.offset);
+
+					VkImageViewCreateInfo viewInfo{};
+					viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+					viewInfo.image = transient.image;
+					viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+					viewInfo.format = transient.desc.format;
+					viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					viewInfo.subresourceRange.baseMipLevel = 0;
+					viewInfo.subresourceRange.levelCount = 1;
+					viewInfo.subresourceRange.baseArrayLayer = 0;
+					viewInfo.subresourceRange.layerCount = 1;
+
+					if (vkCreateImageView(device, &viewInfo, nullptr, &transient.imageView) != VK_SUCCESS)
+					{
+						throw std::runtime_error("Failed to create transient image view!");
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < used.size(); i++)
+		{
+			resources[used[i]].transient = i;
+		}
+
+		/*
+		* The first access of every occupant waits for the last pass of the one before it. The first
+		* occupant follows the last one of the previous execution, which is also how a transient with
+		* a slot of its own waits for the previous frame to be done with it.
+		*/
+		for (const auto& slot : slots)
+		{
+			for (size_t i = 0; i < slot.occupants.size(); i++)
+			{
+				uint32_t previous = slot.occupants[(i + slot.occupants.size() - 1) % slot.occupants.size()];
+				const Access& lastAccess = findAccess(transients[previous].lastPass, used[previous]);
+
+				TransientImage& transient = transients[slot.occupants[i]];
+				transient.aliasStages = lastAccess.readStages | lastAccess.writeStages;
+				transient.aliasAccess = lastAccess.writeAccess;
+			}
+
+			stats.transientMemoryBytes += slot.requirements.size;
+		}
+
+		for (const auto& transient : transients)
+		{
+			stats.transientImageBytes += transient.requirements.size;
+		}
+
+		stats.transientImageCount = static_cast<uint32_t>(transients.size());
+	}
+
+	void MgeRenderGraph::retireTransients(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission)
+	{
+		if (transients.empty())
+		{
+			return;
+		}
+
+		VkDevice logicalDevice = device;
+		MgeAllocator* memoryAllocator = allocator;
+
+		std::vector<TransientImage> oldTransients = std::move(transients);
+		std::vector<MemorySlot> oldSlots = std::move(slots);
+
+		transients.clear();
+		slots.clear();
+
+		deletionQueue.push(lastSubmission, [=]() mutable
+			{
+				for (auto& transient : oldTransients)
+				{
+					vkDestroyImageView(logicalDevice, transient.imageView, nullptr);
+					vkDestroyImage(logicalDevice, transient.image, nullptr);
+				}
+
+				for (auto& slot : oldSlots)
+				{
+					memoryAllocator->free(slot.allocation);
+				}
+			});
+	}
+
+	void MgeRenderGraph::buildBarriers()
+	{
+		std::vector<ResourceState> states(resources.size());
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = resources[i];
+			ResourceState& state = states[i];
+
+			if (resource.imported)
+			{
+				state.layout = resource.initialLayout;
+				state.writeStages = resource.initialStages;
+				state.writeAccess = resource.initialAccess;
+			}
+			else if (resource.firstPass != NO_PASS)
+			{
+				// Comes from UNDEFINED, after whatever used its memory last
+				const TransientImage& transient = transients[resource.transient];
+
+				state.writeStages = transient.aliasStages;
+				state.writeAccess = transient.aliasAccess;
+			}
+		}
+
+		for (auto& pass : passes)
+		{
+			pass.imageBarriers.clear();
+			pass.bufferBarriers.clear();
+
+			if (pass.culled)
+			{
+				continue;
+			}
+
+			for (const auto& access : pass.accesses)
+			{
+				addBarrier(pass, access, states[access.resource]);
+			}
+
+			if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+			{
+				stats.barrierBatchCount++;
+			}
+
+			stats.imageBarrierCount += static_cast<uint32_t>(pass.imageBarriers.size());
+			stats.bufferBarrierCount += static_cast<uint32_t>(pass.bufferBarriers.size());
+		}
+
+		// Imported images end up in the layout the code after the graph expects, one more batch for all of them
+		finalImageBarriers.clear();
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = resources[i];
+			const ResourceState& state = states[i];
+
+			if (resource.imported && resource.isImage && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED &&
+				resource.finalLayout != state.layout)
+			{
+				finalImageBarriers.push_back(makeImageBarrier(resource, state.writeStages | state.readStages, state.writeAccess,
+					VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, state.layout, resource.finalLayout));
+			}
+		}
+
+		if (!finalImageBarriers.empty())
+		{
+			stats.barrierBatchCount++;
+		}
+
+		stats.imageBarrierCount += static_cast<uint32_t>(finalImageBarriers.size());
+	}
+
+	void MgeRenderGraph::addBarrier(Pass& pass, const Access& access, ResourceState& state)
+	{
+		const Resource& resource = resources[access.resource];
+
+		VkPipelineStageFlags2 dstStages = access.readStages | access.writeStages;
+		VkAccessFlags2 dstAccess = access.readAccess | access.writeAccess;
+
+		bool transition = resource.isImage && state.layout != access.layout;
+
+		VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+		bool needed = false;
+
+		if (transition || access.write)
+		{
+			// Writes (and layout transitions, which write too) wait for every access since the last write
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+			needed = transition || srcStages != VK_PIPELINE_STAGE_2_NONE;
+		}
+		else if (state.writeStages != VK_PIPELINE_STAGE_2_NONE &&
+			((dstStages & ~state.visibleStages) != 0 || (dstAccess & ~state.visibleAccess) != 0))
+		{
+			// Read after write, unless an earlier barrier already made the write visible to these reads
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+			needed = true;
+		}
+
+		if (needed)
+		{
+			if (resource.isImage)
+			{
+				pass.imageBarriers.push_back(makeImageBarrier(resource, srcStages, srcAccess, dstStages, dstAccess,
+					transition ? state.layout : access.layout, access.layout));
+			}
+			else
+			{
+				VkBufferMemoryBarrier2 barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+				barrier.srcStageMask = srcStages;
+				barrier.srcAccessMask = srcAccess;
+				barrier.dstStageMask = dstStages;
+				barrier.dstAccessMask = dstAccess;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = resource.buffer;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+
+				pass.bufferBarriers.push_back(barrier);
+			}
+		}
+
+		state.layout = access.layout;
+
+		if (access.write)
+		{
+			state.writeStages = dstStages;
+			state.writeAccess = access.writeAccess;
+			state.readStages = VK_PIPELINE_STAGE_2_NONE;
+			state.visibleStages = VK_PIPELINE_STAGE_2_NONE;
+			state.visibleAccess = VK_ACCESS_2_NONE;
+		}
+		else if (transition)
+		{
+			// Later reads at other stages chain on the stages that waited for the transition
+			state.writeStages = dstStages;
+			state.writeAccess = VK_ACCESS_2_NONE;
+			state.readStages = dstStages;
+			state.visibleStages = dstStages;
+			state.visibleAccess = dstAccess;
+		}
+		else
+		{
+			state.readStages |= dstStages;
+
+			if (needed)
+			{
+				state.visibleStages |= dstStages;
+				state.visibleAccess |= dstAccess;
+			}
+		}
+	}
+
+	VkImageMemoryBarrier2 MgeRenderGraph::makeImageBarrier(const Resource& resource, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+		VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) const
+	{
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = srcStages;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = dstStages;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.imported ? resource.image : transients[resource.transient].image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		return barrier;
+	}
+
+	void MgeRenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2>& imageBarriers,
+		const std::vector<VkBufferMemoryBarrier2>& bufferBarriers)
+	{
+		if (imageBarriers.empty() && bufferBarriers.empty())
+		{
+			return;
+		}
+
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.bufferMemoryBarrierCount = static_cast<unsigned int>(bufferBarriers.size());
+		dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = static_cast<unsigned int>(imageBarriers.size());
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+}
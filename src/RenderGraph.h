@@ -0,0 +1,277 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+namespace mge {
+
+	using MgeRenderResource = uint32_t;
+
+	// An image the graph creates itself, it only lives from its first to its last pass
+	struct MgeTransientImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = { 0, 0 };
+		VkImageUsageFlags usage = 0;
+
+		bool operator==(const MgeTransientImageDesc& other) const
+		{
+			return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height &&
+				usage == other.usage;
+		}
+	};
+
+	/*
+	* Render graph
+	*
+	* The frame is declared as a list of passes, each stating which resources it reads and writes,
+	* at which pipeline stages, with which access and (images) in which layout:
+	*
+	*     MgeRenderResource target = graph.importImage("swapchain", image, view, ...);
+	*     MgeRenderResource scene = graph.createImage("scene_color", { format, extent, usage });
+	*
+	*     graph.addPass("main", [&](VkCommandBuffer commandBuffer) { ... })
+	*         .write(scene, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+	*             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	*
+	*     graph.markOutput(target);
+	*     graph.compile(deletionQueue, lastSubmission);
+	*     graph.execute(commandBuffer);
+	*
+	* compile() then
+	*
+	*   - culls the passes nothing marked as an output depends on,
+	*   - walks the remaining passes in order and works out the layout transitions and the
+	*     read-after-write, write-after-read and write-after-write dependencies between them.
+	*     Everything one pass needs is recorded as a single vkCmdPipelineBarrier2 before it,
+	*     consecutive reads in the same layout need no barrier at all,
+	*   - creates the transient images. Transients whose lifetimes (first to last pass) do not overlap
+	*     are bound to the same memory, the first access of each one comes from UNDEFINED and waits
+	*     for the last access of whatever used the memory before it (in this frame or, for the first
+	*     one, in the previous frame, earlier on the same queue).
+	*
+	* The graph is meant to be declared again for every command buffer it records, reset() drops the
+	* passes and resources. Transient images stay cached for as long as the transients and their
+	* lifetimes do not change, otherwise the old ones go through the deletion queue.
+	*
+	* Passes record their own work, dynamic rendering or render pass instances included. Barriers
+	* inside a pass (between a clear and a dispatch, for example) are up to the pass too.
+	*/
+	class MgeRenderGraph
+	{
+	public:
+		using Execute = std::function<void(VkCommandBuffer commandBuffer)>;
+
+		struct Stats
+		{
+			uint32_t passCount = 0;
+			uint32_t culledPassCount = 0;
+			uint32_t barrierBatchCount = 0;		// vkCmdPipelineBarrier2 calls per execute()
+			uint32_t imageBarrierCount = 0;
+			uint32_t bufferBarrierCount = 0;
+			uint32_t transientImageCount = 0;
+			VkDeviceSize transientImageBytes = 0;	// What the transients would take without aliasing
+			VkDeviceSize transientMemoryBytes = 0;	// What they take
+		};
+
+		// Declares what a pass does with its resources, returned by addPass()
+		class PassBuilder
+		{
+		public:
+			PassBuilder& read(MgeRenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+				VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+			PassBuilder& write(MgeRenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+				VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		private:
+			friend class MgeRenderGraph;
+
+			PassBuilder(MgeRenderGraph& renderGraph, uint32_t passIndex) : graph(renderGraph), pass(passIndex) {}
+
+			MgeRenderGraph& graph;
+			uint32_t pass;
+		};
+
+		MgeRenderGraph() = default;
+
+		MgeRenderGraph(const MgeRenderGraph&) = delete;
+		MgeRenderGraph& operator=(const MgeRenderGraph&) = delete;
+
+		void init(VkDevice logicalDevice, MgeAllocator& memoryAllocator);
+
+		// Only called once the device is idle
+		void destroy();
+
+		// Drops the passes and resources, the transient images stay cached
+		void reset();
+
+		/*
+		* The image is in initialLayout when the graph starts, last accessed at initialStages (an
+		* acquire semaphore's wait stage, for example). finalLayout is the layout the graph leaves it
+		* in, UNDEFINED leaves it in the layout of its last pass.
+		*/
+		MgeRenderResource importImage(const std::string& name, VkImage image, VkImageView imageView,
+			VkImageLayout initialLayout, VkPipelineStageFlags2 initialStages, VkImageLayout finalLayout);
+
+		// The buffer was last accessed at initialStages before the graph starts. initialAccess are the
+		// writes made then that the passes have to see, NONE when the buffer was only read.
+		MgeRenderResource importBuffer(const std::string& name, VkBuffer buffer,
+			VkPipelineStageFlags2 initialStages, VkAccessFlags2 initialAccess);
+
+		MgeRenderResource createImage(const std::string& name, const MgeTransientImageDesc& desc);
+
+		PassBuilder addPass(const std::string& name, Execute execute);
+
+		// The resource is used after the graph (presented, read back, ...), the passes writing it are never culled
+		void markOutput(MgeRenderResource resource);
+
+		void compile(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission);
+
+		void execute(VkCommandBuffer commandBuffer);
+
+		// Valid after compile()
+		VkImage getImage(MgeRenderResource resource) const;
+
+		VkImageView getImageView(MgeRenderResource resource) const;
+
+		VkBuffer getBuffer(MgeRenderResource resource) const;
+
+		const Stats& getStats() const { return stats; }
+
+	private:
+		static const uint32_t NO_PASS = UINT32_MAX;
+
+		// Everything one pass does with one resource, reads and writes merged
+		struct Access
+		{
+			MgeRenderResource resource = 0;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			bool read = false;
+			bool write = false;
+
+			VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+			VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			bool isImage = false;
+			bool imported = false;
+			bool output = false;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+
+			// Imported resources
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags2 initialStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 initialAccess = VK_ACCESS_2_NONE;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// Transient images
+			MgeTransientImageDesc desc;
+			uint32_t transient = 0;		// Index into transients once compiled
+
+			// Passes that are kept, set by compile()
+			uint32_t firstPass = NO_PASS;
+			uint32_t lastPass = NO_PASS;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			Execute execute;
+			std::vector<Access> accesses;	// One per resource
+			bool culled = false;
+
+			std::vector<VkImageMemoryBarrier2> imageBarriers;
+			std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+		};
+
+		// Where a resource is at while compile() walks the passes
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;	// Last write (or layout transition)
+			VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+			VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;		// Reads since then
+			VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;	// Reads the last write is visible to
+			VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+		};
+
+		// A transient image, cached from one compile() to the next
+		struct TransientImage
+		{
+			MgeTransientImageDesc desc;
+			uint32_t firstPass = 0;
+			uint32_t lastPass = 0;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			VkMemoryRequirements requirements{};
+			bool dedicated = false;		// The driver requires its own memory, never shared
+			uint32_t slot = 0;
+
+			// Last pass' access of the transient sharing the memory before this one (its first access waits on it)
+			VkPipelineStageFlags2 aliasStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 aliasAccess = VK_ACCESS_2_NONE;
+		};
+
+		// Memory shared by transients with disjoint lifetimes, occupants in pass order
+		struct MemorySlot
+		{
+			MgeAllocation allocation;
+			VkMemoryRequirements requirements{};
+			bool dedicated = false;
+			std::vector<uint32_t> occupants;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		MgeAllocator* allocator = nullptr;
+
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+
+		std::vector<TransientImage> transients;
+		std::vector<MemorySlot> slots;
+
+		std::vector<VkImageMemoryBarrier2> finalImageBarriers;
+
+		Stats stats;
+
+		void addAccess(uint32_t pass, MgeRenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+			VkImageLayout layout, bool write);
+
+		const Access& findAccess(uint32_t pass, MgeRenderResource resource) const;
+
+		void cullPasses();
+
+		// Creates (or keeps) the transient images and their shared memory
+		void allocateTransients(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission);
+
+		void retireTransients(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission);
+
+		void buildBarriers();
+
+		// Adds whatever barrier access needs to the pass, then moves state past it
+		void addBarrier(Pass& pass, const Access& access, ResourceState& state);
+
+		VkImageMemoryBarrier2 makeImageBarrier(const Resource& resource, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+			VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) const;
+
+		static void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2>& imageBarriers,
+			const std::vector<VkBufferMemoryBarrier2>& bufferBarriers);
+	};
+}
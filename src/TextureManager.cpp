@@ -0,0 +1,1048 @@
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeTextureManager::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, MgeAllocator& memoryAllocator, MgeBindlessTable& bindlessTable,
+		VkQueue graphicsQueue, unsigned int graphicsQueueFamily, VkDeviceSize budgetBytes)
+	{
+		device = logicalDevice;
+		allocator = &memoryAllocator;
+		bindless = &bindlessTable;
+		queue = graphicsQueue;
+		budget = budgetBytes;
+
+		// Mip levels are generated with linear filtered blits
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, TEXTURE_FORMAT, &formatProperties);
+
+		VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+		{
+			throw std::runtime_error("Failed to find linear blit support for the texture format!");
+		}
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = graphicsQueueFamily;
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture command pool!");
+		}
+
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &timelineInfo;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture timeline semaphore!");
+		}
+
+		// One sampler for every texture, a streamed out image simply has fewer levels to pick from
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture sampler!");
+		}
+
+		allocator->createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingRing, stagingRingAllocation);
+
+		// The fallback is the only upload that is waited for, every texture shows it until it is ready
+		fallback.data.width = 1;
+		fallback.data.height = 1;
+		fallback.data.levels = { { 255, 255, 255, 255 } };
+		fallback.mipCount = 1;
+		fallback.loaded = true;
+
+		Replacement replacement = recordStreamIn(fallback, 0);
+
+		submit();
+
+		uint64_t waitValue = submittedSerial;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &waitValue;
+
+		if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait for the fallback texture!");
+		}
+
+		fallback.image = replacement.image;
+		fallback.imageView = replacement.imageView;
+		fallback.allocation = replacement.allocation;
+		fallback.streaming = false;
+		fallback.handle = bindless->registerTexture(sampler, fallback.imageView);
+
+		fallbackHandle = fallback.handle;
+
+		stopping = false;
+		loaderThread = std::thread(&MgeTextureManager::loaderLoop, this);
+	}
+
+	void MgeTextureManager::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(loaderMutex);
+			stopping = true;
+		}
+
+		loadAvailable.notify_all();
+
+		if (loaderThread.joinable())
+		{
+			loaderThread.join();
+		}
+
+		// Only called once the device is idle, every submission has finished
+		for (auto& submission : pendingSubmissions)
+		{
+			for (auto& [buffer, allocation] : submission.stagingBuffers)
+			{
+				allocator->destroyBuffer(buffer, allocation);
+			}
+
+			// Never swapped in, nothing else refers to these images
+			for (auto& replacement : submission.replacements)
+			{
+				vkDestroyImageView(device, replacement.imageView, nullptr);
+				vkDestroyImage(device, replacement.image, nullptr);
+				allocator->free(replacement.allocation);
+			}
+		}
+
+		pendingSubmissions.clear();
+
+		if (stagingRing != VK_NULL_HANDLE)
+		{
+			allocator->destroyBuffer(stagingRing, stagingRingAllocation);
+			stagingRing = VK_NULL_HANDLE;
+		}
+
+		stagingHead = 0;
+		stagingUsed = 0;
+
+		auto destroyImage = [this](Texture& texture)
+			{
+				if (texture.image != VK_NULL_HANDLE)
+				{
+					vkDestroyImageView(device, texture.imageView, nullptr);
+					vkDestroyImage(device, texture.image, nullptr);
+					allocator->free(texture.allocation);
+				}
+			};
+
+		for (auto& texture : textures)
+		{
+			destroyImage(texture);
+		}
+
+		destroyImage(fallback);
+
+		textures.clear();
+		fallback = Texture{};
+		fallbackHandle = MGE_INVALID_BINDLESS_HANDLE;
+
+		loadQueue.clear();
+		loadedTextures.clear();
+		waitingUploads.clear();
+
+		if (sampler != VK_NULL_HANDLE)
+		{
+			vkDestroySampler(device, sampler, nullptr);
+			sampler = VK_NULL_HANDLE;
+		}
+
+		if (timeline != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(device, timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+
+		// Destroying the pool frees the command buffers
+		if (commandPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			commandPool = VK_NULL_HANDLE;
+		}
+
+		freeCommandBuffers.clear();
+		residentBytes = 0;
+	}
+
+	MgeTextureId MgeTextureManager::load(Loader loader)
+	{
+		MgeTextureId id = static_cast<MgeTextureId>(textures.size());
+		textures.emplace_back();
+
+		{
+			std::lock_guard<std::mutex> lock(loaderMutex);
+			loadQueue.emplace_back(id, std::move(loader));
+			pendingLoads++;
+		}
+
+		loadAvailable.notify_one();
+
+		return id;
+	}
+
+	void MgeTextureManager::request(MgeTextureId texture, float screenSize)
+	{
+		Texture& requested = textures[texture];
+
+		// Drawn more than once this frame, the largest draw decides
+		requested.screenSize = requested.lastUsed == frame ? std::max(requested.screenSize, screenSize) : screenSize;
+		requested.lastUsed = frame;
+	}
+
+	void MgeTextureManager::update(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission)
+	{
+		std::vector<std::pair<MgeTextureId, MgeTextureData>> loaded;
+		std::exception_ptr error;
+
+		{
+			std::lock_guard<std::mutex> lock(loaderMutex);
+
+			error = loaderError;
+			loaded.swap(loadedTextures);
+			pendingLoads -= static_cast<uint32_t>(loaded.size());
+		}
+
+		// A failed load is reported on the main thread like any other error
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+
+		retireSubmissions(deletionQueue, lastSubmission);
+
+		for (auto& [id, data] : loaded)
+		{
+			Texture& texture = textures[id];
+			texture.data = std::move(data);
+			texture.mipCount = static_cast<uint32_t>(std::floor(std::log2(std::max(texture.data.width, texture.data.height)))) + 1;
+			texture.loaded = true;
+
+			waitingUploads.push_back(id);
+		}
+
+		updateUploadBytes = 0;
+
+		// First uploads, as many as the staging limit allows but at least one whenever the ring has room
+		while (!waitingUploads.empty())
+		{
+			MgeTextureId id = waitingUploads.front();
+			Texture& texture = textures[id];
+
+			uint32_t residentMip = std::min(getWantedMip(texture), static_cast<uint32_t>(texture.data.levels.size()) - 1);
+			VkDeviceSize stagingBytes = getLevelBytes(texture, residentMip, static_cast<uint32_t>(texture.data.levels.size()));
+
+			if (updateUploadBytes > 0 && updateUploadBytes + stagingBytes > MAX_UPDATE_UPLOAD_BYTES)
+			{
+				break;
+			}
+
+			// The ring is still busy with earlier updates, try again next time
+			if (!hasStagingSpace(stagingBytes))
+			{
+				break;
+			}
+
+			Replacement replacement = recordStreamIn(texture, residentMip);
+			replacement.texture = id;
+			currentSubmission.replacements.push_back(replacement);
+
+			waitingUploads.pop_front();
+		}
+
+		balanceResidency();
+
+		if (recording)
+		{
+			submit();
+		}
+
+		frame++;
+
+		// request() calls from here on that change a wanted level leave work for the next update()
+		for (Texture& texture : textures)
+		{
+			texture.balancedMip = getWantedMip(texture);
+		}
+	}
+
+	uint32_t MgeTextureManager::getBindlessHandle(MgeTextureId texture) const
+	{
+		uint32_t handle = textures[texture].handle;
+
+		return handle != MGE_INVALID_BINDLESS_HANDLE ? handle : fallbackHandle;
+	}
+
+	MgeTextureManager::Stats MgeTextureManager::getStats() const
+	{
+		Stats stats;
+		stats.textureCount = static_cast<uint32_t>(textures.size());
+		stats.residentBytes = residentBytes;
+		stats.budgetBytes = budget;
+		stats.streamedIn = streamedIn;
+		stats.streamedOut = streamedOut;
+		stats.uploadedBytes = uploadedBytes;
+
+		for (const auto& texture : textures)
+		{
+			if (texture.image != VK_NULL_HANDLE)
+			{
+				stats.residentCount++;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(loaderMutex);
+			stats.pendingLoads = pendingLoads;
+		}
+
+		return stats;
+	}
+
+	bool MgeTextureManager::hasPendingWork() const
+	{
+		if (!waitingUploads.empty() || !pendingSubmissions.empty())
+		{
+			return true;
+		}
+
+		// Drawn at a new size since the last update(), residency has not been balanced for it yet
+		for (const Texture& texture : textures)
+		{
+			if (texture.image != VK_NULL_HANDLE && !texture.streaming && getWantedMip(texture) != texture.balancedMip)
+			{
+				return true;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(loaderMutex);
+
+		return !loadedTextures.empty() || loaderError != nullptr;
+	}
+
+	void MgeTextureManager::loaderLoop()
+	{
+		for (;;)
+		{
+			std::pair<MgeTextureId, Loader> job;
+
+			{
+				std::unique_lock<std::mutex> lock(loaderMutex);
+
+				loadAvailable.wait(lock, [this]() { return stopping || !loadQueue.empty(); });
+
+				if (stopping)
+				{
+					return;
+				}
+
+				job = std::move(loadQueue.front());
+				loadQueue.pop_front();
+			}
+
+			MgeTextureData data;
+			bool failed = false;
+
+			try
+			{
+				data = job.second();
+
+				if (data.width == 0 || data.height == 0 || data.levels.empty())
+				{
+					throw std::runtime_error("Texture loader returned no texel data!");
+				}
+
+				for (size_t level = 0; level < data.levels.size(); level++)
+				{
+					VkDeviceSize width = std::max(1u, data.width >> level);
+					VkDeviceSize height = std::max(1u, data.height >> level);
+
+					if (data.levels[level].size() != width * height * TEXEL_SIZE)
+					{
+						throw std::runtime_error("Texture level does not match the texture size!");
+					}
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(loaderMutex);
+
+				if (!loaderError)
+				{
+					loaderError = std::current_exception();
+				}
+
+				pendingLoads--;
+				failed = true;
+			}
+
+			if (!failed)
+			{
+				std::lock_guard<std::mutex> lock(loaderMutex);
+				loadedTextures.emplace_back(job.first, std::move(data));
+			}
+
+			// Outside the lock, the callback may well wake the main thread straight into update()
+			if (loadedCallback)
+			{
+				loadedCallback();
+			}
+		}
+	}
+
+	void MgeTextureManager::retireSubmissions(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission)
+	{
+		unsigned long long completed = getCompletedSerial();
+
+		while (!pendingSubmissions.empty() && pendingSubmissions.front().serial <= completed)
+		{
+			Submission& submission = pendingSubmissions.front();
+
+			stagingUsed -= submission.stagingRingBytes;
+
+			for (auto& [buffer, allocation] : submission.stagingBuffers)
+			{
+				allocator->destroyBuffer(buffer, allocation);
+			}
+
+			for (const auto& replacement : submission.replacements)
+			{
+				Texture& texture = textures[replacement.texture];
+
+				if (texture.image != VK_NULL_HANDLE)
+				{
+					// Frames submitted so far may still sample the old image through the old handle
+					VkDevice logicalDevice = device;
+					MgeAllocator* memoryAllocator = allocator;
+					MgeBindlessTable* table = bindless;
+					VkImage oldImage = texture.image;
+					VkImageView oldImageView = texture.imageView;
+					MgeAllocation oldAllocation = texture.allocation;
+					uint32_t oldHandle = texture.handle;
+
+					deletionQueue.push(lastSubmission, [=]() mutable
+						{
+							vkDestroyImageView(logicalDevice, oldImageView, nullptr);
+							vkDestroyImage(logicalDevice, oldImage, nullptr);
+							memoryAllocator->free(oldAllocation);
+							table->releaseTexture(oldHandle);
+						});
+				}
+
+				texture.image = replacement.image;
+				texture.imageView = replacement.imageView;
+				texture.allocation = replacement.allocation;
+				texture.residentMip = replacement.residentMip;
+				texture.handle = bindless->registerTexture(sampler, texture.imageView);
+				texture.streaming = false;
+			}
+
+			freeCommandBuffers.push_back(submission.commandBuffer);
+			pendingSubmissions.pop_front();
+		}
+	}
+
+	void MgeTextureManager::balanceResidency()
+	{
+		std::vector<MgeTextureId> candidates;
+
+		VkDeviceSize lowWaterBytes = budget / 100 * LOW_WATER_PERCENT;
+
+		if (residentBytes > budget)
+		{
+			for (MgeTextureId id = 0; id < textures.size(); id++)
+			{
+				const Texture& texture = textures[id];
+
+				if (texture.image != VK_NULL_HANDLE && !texture.streaming && texture.residentMip < getTailMip(texture))
+				{
+					candidates.push_back(id);
+				}
+			}
+
+			// Textures holding more than they need go first, then the least recently used, larger ones before smaller
+			std::sort(candidates.begin(), candidates.end(), [this](MgeTextureId a, MgeTextureId b)
+				{
+					const Texture& first = textures[a];
+					const Texture& second = textures[b];
+
+					bool firstSurplus = first.residentMip < getWantedMip(first);
+					bool secondSurplus = second.residentMip < getWantedMip(second);
+
+					if (firstSurplus != secondSurplus)
+					{
+						return firstSurplus;
+					}
+
+					if (first.lastUsed != second.lastUsed)
+					{
+						return first.lastUsed < second.lastUsed;
+					}
+
+					return first.allocation.size > second.allocation.size;
+				});
+
+			VkDeviceSize projectedBytes = residentBytes;
+
+			for (MgeTextureId id : candidates)
+			{
+				if (projectedBytes <= lowWaterBytes)
+				{
+					break;
+				}
+
+				Texture& texture = textures[id];
+
+				uint32_t residentMip = std::max(getWantedMip(texture), texture.residentMip + 1);
+
+				projectedBytes -= texture.allocation.size - std::min(texture.allocation.size, getImageBytes(texture, residentMip));
+
+				Replacement replacement = recordStreamOut(texture, residentMip);
+				replacement.texture = id;
+				currentSubmission.replacements.push_back(replacement);
+			}
+
+			return;
+		}
+
+		for (MgeTextureId id = 0; id < textures.size(); id++)
+		{
+			const Texture& texture = textures[id];
+
+			if (texture.image != VK_NULL_HANDLE && !texture.streaming && getWantedMip(texture) < texture.residentMip)
+			{
+				candidates.push_back(id);
+			}
+		}
+
+		// Most recently used first, then the ones missing the most detail
+		std::sort(candidates.begin(), candidates.end(), [this](MgeTextureId a, MgeTextureId b)
+			{
+				const Texture& first = textures[a];
+				const Texture& second = textures[b];
+
+				if (first.lastUsed != second.lastUsed)
+				{
+					return first.lastUsed > second.lastUsed;
+				}
+
+				return first.residentMip - getWantedMip(first) > second.residentMip - getWantedMip(second);
+			});
+
+		VkDeviceSize projectedBytes = residentBytes;
+
+		for (MgeTextureId id : candidates)
+		{
+			Texture& texture = textures[id];
+
+			// Only levels that are still in system memory can come back
+			uint32_t providedCount = static_cast<uint32_t>(texture.data.levels.size());
+			uint32_t residentMip = std::min(getWantedMip(texture), providedCount - 1);
+
+			if (residentMip >= texture.residentMip)
+			{
+				continue;
+			}
+
+			VkDeviceSize imageBytes = getImageBytes(texture, residentMip);
+			VkDeviceSize stagingBytes = getLevelBytes(texture, residentMip, providedCount);
+
+			if (projectedBytes - texture.allocation.size + imageBytes > lowWaterBytes)
+			{
+				continue;
+			}
+
+			if (updateUploadBytes > 0 && updateUploadBytes + stagingBytes > MAX_UPDATE_UPLOAD_BYTES)
+			{
+				break;
+			}
+
+			if (!hasStagingSpace(stagingBytes))
+			{
+				break;
+			}
+
+			projectedBytes = projectedBytes - texture.allocation.size + imageBytes;
+
+			Replacement replacement = recordStreamIn(texture, residentMip);
+			replacement.texture = id;
+			currentSubmission.replacements.push_back(replacement);
+		}
+	}
+
+	MgeTextureManager::Replacement MgeTextureManager::recordStreamIn(Texture& texture, uint32_t residentMip)
+	{
+		if (!recording)
+		{
+			beginSubmission();
+		}
+
+		VkCommandBuffer commandBuffer = currentSubmission.commandBuffer;
+
+		uint32_t providedCount = std::min(static_cast<uint32_t>(texture.data.levels.size()), texture.mipCount);
+		uint32_t levelCount = texture.mipCount - residentMip;
+
+		Replacement replacement;
+		replacement.residentMip = residentMip;
+
+		createImage(std::max(1u, texture.data.width >> residentMip), std::max(1u, texture.data.height >> residentMip), levelCount, replacement);
+
+		// The old image counts as gone from here on, it is released as soon as this one is ready
+		residentBytes += replacement.allocation.size;
+
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			residentBytes -= texture.allocation.size;
+		}
+
+		// Every level the data provides goes into one range of the staging ring
+		VkDeviceSize stagingSize = getLevelBytes(texture, residentMip, providedCount);
+
+		VkBuffer stagingBuffer = stagingRing;
+		char* stagingData = static_cast<char*>(stagingRingAllocation.mapped);
+		VkDeviceSize stagingOffset = 0;
+
+		// The callers made sure anything that fits the ring has room, so only oversized uploads end up here
+		if (!reserveStaging(stagingSize, stagingOffset))
+		{
+			MgeAllocation stagingAllocation;
+
+			allocator->createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingAllocation);
+
+			currentSubmission.stagingBuffers.emplace_back(stagingBuffer, stagingAllocation);
+
+			stagingData = static_cast<char*>(stagingAllocation.mapped);
+			stagingOffset = 0;
+		}
+
+		transitionLevels(replacement.image, 0, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		std::vector<VkBufferImageCopy> regions;
+
+		for (uint32_t level = residentMip; level < providedCount; level++)
+		{
+			const auto& texels = texture.data.levels[level];
+
+			std::memcpy(stagingData + stagingOffset, texels.data(), texels.size());
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingOffset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level - residentMip;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { std::max(1u, texture.data.width >> level), std::max(1u, texture.data.height >> level), 1 };
+
+			regions.push_back(region);
+
+			stagingOffset += texels.size();
+		}
+
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, replacement.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<unsigned int>(regions.size()), regions.data());
+
+		/*
+		* Generating the missing levels
+		* Each level is blitted down from the one above it, which is moved to TRANSFER_SRC for the blit
+		* and on to SHADER_READ_ONLY once it has been read.
+		*/
+		for (uint32_t level = providedCount; level < texture.mipCount; level++)
+		{
+			uint32_t source = level - 1 - residentMip;
+
+			transitionLevels(replacement.image, source, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, source, 0, 1 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(std::max(1u, texture.data.width >> (level - 1))),
+				static_cast<int32_t>(std::max(1u, texture.data.height >> (level - 1))), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, source + 1, 0, 1 };
+			blit.dstOffsets[1] = { static_cast<int32_t>(std::max(1u, texture.data.width >> level)),
+				static_cast<int32_t>(std::max(1u, texture.data.height >> level)), 1 };
+
+			vkCmdBlitImage(commandBuffer, replacement.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				replacement.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			transitionLevels(replacement.image, source, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+
+		// Whatever is still a copy or blit destination: uploaded levels no blit read from, and the last level
+		if (providedCount < texture.mipCount)
+		{
+			if (providedCount - 1 > residentMip)
+			{
+				transitionLevels(replacement.image, 0, providedCount - 1 - residentMip, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			}
+
+			transitionLevels(replacement.image, levelCount - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else
+		{
+			transitionLevels(replacement.image, 0, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+
+		texture.streaming = true;
+
+		updateUploadBytes += stagingSize;
+		uploadedBytes += stagingSize;
+		streamedIn++;
+
+		return replacement;
+	}
+
+	MgeTextureManager::Replacement MgeTextureManager::recordStreamOut(Texture& texture, uint32_t residentMip)
+	{
+		if (!recording)
+		{
+			beginSubmission();
+		}
+
+		VkCommandBuffer commandBuffer = currentSubmission.commandBuffer;
+
+		uint32_t levelCount = texture.mipCount - residentMip;
+		uint32_t skippedLevels = residentMip - texture.residentMip;
+
+		Replacement replacement;
+		replacement.residentMip = residentMip;
+
+		createImage(std::max(1u, texture.data.width >> residentMip), std::max(1u, texture.data.height >> residentMip), levelCount, replacement);
+
+		residentBytes += replacement.allocation.size;
+		residentBytes -= texture.allocation.size;
+
+		transitionLevels(replacement.image, 0, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		// Frames submitted earlier may still be sampling the old image, the copy waits for them
+		transitionLevels(texture.image, skippedLevels, levelCount, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		std::vector<VkImageCopy> regions(levelCount);
+
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			regions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, skippedLevels + i, 0, 1 };
+			regions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+			regions[i].extent = { std::max(1u, texture.data.width >> (residentMip + i)), std::max(1u, texture.data.height >> (residentMip + i)), 1 };
+		}
+
+		vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, replacement.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<unsigned int>(regions.size()), regions.data());
+
+		// Frames submitted before the new image is swapped in keep sampling the old one
+		transitionLevels(texture.image, skippedLevels, levelCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		transitionLevels(replacement.image, 0, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		texture.streaming = true;
+
+		streamedOut++;
+
+		return replacement;
+	}
+
+	void MgeTextureManager::createImage(uint32_t width, uint32_t height, uint32_t mipCount, Replacement& replacement)
+	{
+		VkImageCreateInfo imageInfo = getImageInfo(width, height, mipCount);
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &replacement.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture image!");
+		}
+
+		allocator->bindImage(replacement.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, replacement.allocation);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = replacement.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = TEXTURE_FORMAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipCount;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &viewInfo, nullptr, &replacement.imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture image view!");
+		}
+	}
+
+	VkImageCreateInfo MgeTextureManager::getImageInfo(uint32_t width, uint32_t height, uint32_t mipCount)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = TEXTURE_FORMAT;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = mipCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		return imageInfo;
+	}
+
+	VkDeviceSize MgeTextureManager::getImageBytes(const Texture& texture, uint32_t residentMip) const
+	{
+		VkImageCreateInfo imageInfo = getImageInfo(std::max(1u, texture.data.width >> residentMip), std::max(1u, texture.data.height >> residentMip),
+			texture.mipCount - residentMip);
+
+		// The same size the allocator hands out for the image once it exists
+		VkDeviceImageMemoryRequirements requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+		requirementsInfo.pCreateInfo = &imageInfo;
+
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+
+		vkGetDeviceImageMemoryRequirements(device, &requirementsInfo, &requirements);
+
+		return requirements.memoryRequirements.size;
+	}
+
+	bool MgeTextureManager::hasStagingSpace(VkDeviceSize size) const
+	{
+		// Larger than the whole ring, recordStreamIn() gives it a buffer of its own
+		if (size > STAGING_RING_SIZE)
+		{
+			return true;
+		}
+
+		VkDeviceSize offset;
+		VkDeviceSize consumed;
+
+		return findStagingSpace(size, offset, consumed);
+	}
+
+	bool MgeTextureManager::findStagingSpace(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed) const
+	{
+		// An empty ring can start over at the front, no wrap padding needed
+		VkDeviceSize head = stagingUsed == 0 ? 0 : stagingHead;
+		VkDeviceSize aligned = (head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+		if (aligned + size <= STAGING_RING_SIZE)
+		{
+			offset = aligned;
+			consumed = aligned + size - head;
+		}
+		else
+		{
+			// Does not fit before the end, skip the tail of the ring and start at 0
+			offset = 0;
+			consumed = STAGING_RING_SIZE - head + size;
+		}
+
+		return stagingUsed + consumed <= STAGING_RING_SIZE;
+	}
+
+	bool MgeTextureManager::reserveStaging(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		VkDeviceSize consumed;
+
+		if (!findStagingSpace(size, offset, consumed))
+		{
+			return false;
+		}
+
+		stagingHead = (offset + size) % STAGING_RING_SIZE;
+		stagingUsed += consumed;
+		currentSubmission.stagingRingBytes += consumed;
+
+		return true;
+	}
+
+	void MgeTextureManager::transitionLevels(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseLevel;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(currentSubmission.commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void MgeTextureManager::beginSubmission()
+	{
+		currentSubmission = Submission{};
+
+		if (!freeCommandBuffers.empty())
+		{
+			currentSubmission.commandBuffer = freeCommandBuffers.back();
+			freeCommandBuffers.pop_back();
+
+			vkResetCommandBuffer(currentSubmission.commandBuffer, 0);
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &currentSubmission.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate texture command buffer!");
+			}
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(currentSubmission.commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin texture command buffer!");
+		}
+
+		recording = true;
+	}
+
+	void MgeTextureManager::submit()
+	{
+		if (vkEndCommandBuffer(currentSubmission.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record texture command buffer!");
+		}
+
+		currentSubmission.serial = submittedSerial + 1;
+
+		uint64_t signalValue = currentSubmission.serial;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &currentSubmission.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+
+		if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit texture uploads!");
+		}
+
+		submittedSerial = currentSubmission.serial;
+		pendingSubmissions.push_back(std::move(currentSubmission));
+
+		currentSubmission = Submission{};
+		recording = false;
+	}
+
+	uint32_t MgeTextureManager::getWantedMip(const Texture& texture) const
+	{
+		uint32_t tailMip = getTailMip(texture);
+
+		if (texture.lastUsed == 0 || texture.lastUsed + RECENT_FRAMES <= frame || texture.screenSize <= 0.0f)
+		{
+			return tailMip;
+		}
+
+		// One texel per pixel: every halving of the on-screen size drops a level
+		float largest = static_cast<float>(std::max(texture.data.width, texture.data.height));
+
+		if (texture.screenSize >= largest)
+		{
+			return 0;
+		}
+
+		return std::min(static_cast<uint32_t>(std::floor(std::log2(largest / texture.screenSize))), tailMip);
+	}
+
+	uint32_t MgeTextureManager::getTailMip(const Texture& texture) const
+	{
+		uint32_t mip = 0;
+
+		while (mip + 1 < texture.mipCount && std::max(texture.data.width >> mip, texture.data.height >> mip) > MIP_TAIL_SIZE)
+		{
+			mip++;
+		}
+
+		return mip;
+	}
+
+	VkDeviceSize MgeTextureManager::getLevelBytes(const Texture& texture, uint32_t firstLevel, uint32_t endLevel) const
+	{
+		VkDeviceSize bytes = 0;
+
+		for (uint32_t level = firstLevel; level < endLevel; level++)
+		{
+			bytes += static_cast<VkDeviceSize>(std::max(1u, texture.data.width >> level)) * std::max(1u, texture.data.height >> level) * TEXEL_SIZE;
+		}
+
+		return bytes;
+	}
+
+	unsigned long long MgeTextureManager::getCompletedSerial()
+	{
+		uint64_t value = 0;
+
+		vkGetSemaphoreCounterValue(device, timeline, &value);
+
+		return value;
+	}
+}
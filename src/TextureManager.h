@@ -0,0 +1,271 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+namespace mge {
+
+	using MgeTextureId = uint32_t;
+
+	/*
+	* Texel data of one texture, tightly packed RGBA8 (sRGB), one entry per mip level starting with the
+	* full size image. A single level (or any incomplete chain) is completed on the GPU with blits.
+	*/
+	struct MgeTextureData
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<std::vector<uint8_t>> levels;
+	};
+
+	/*
+	* Streaming texture manager
+	*
+	* load() only queues the loader function and returns an id. The loader (decoding, procedural
+	* generation, ...) runs on the manager's own loader thread. update(), called once per frame,
+	* picks up finished loads and records their uploads: staging copies for every level the data
+	* provides, then vkCmdBlitImage down the rest of the chain. One submission on the graphics queue
+	* (blits need it) per update, tracked with a timeline semaphore, so update() never waits either.
+	*
+	* The texels are staged in a persistently mapped ring (STAGING_RING_SIZE) whose space comes back
+	* as submissions finish, nothing is allocated per upload. The copy into it runs on the render
+	* thread, so each update() stages at most MAX_UPDATE_UPLOAD_BYTES and leaves the rest for the
+	* following ones, as it does when the ring is still busy. Only an upload larger than the whole
+	* ring gets a staging buffer of its own.
+	*
+	* Residency
+	*
+	* Texel data stays in system memory, the GPU only holds the levels from the texture's resident
+	* mip down. Every frame the renderer calls request() with the on-screen size of each texture it
+	* draws, which gives the level it needs. update() then keeps the textures within the VRAM budget:
+	*
+	*   - over budget, textures give up their most detailed level, least recently used and those
+	*     holding more than they need first. The smaller image is filled with vkCmdCopyImage from the
+	*     resident levels, nothing is read back or uploaded,
+	*   - under budget, textures that need more detail stream it back in from system memory, most
+	*     recently used first, as long as the budget allows.
+	*
+	* Both sides count the memory the images really take (vkGetDeviceImageMemoryRequirements, padding
+	* and alignment included), not their texel bytes. Streaming out goes down to LOW_WATER_PERCENT of
+	* the budget and streaming in stops there, so a texture streamed back in never pushes residency
+	* over the budget again and starts the next round of streaming out.
+	*
+	* Levels of 32 x 32 and below (the mip tail) always stay resident. Textures whose chain was
+	* generated on the GPU only keep their top level in system memory and stream back in fully.
+	*
+	* Streaming replaces the image, so a texture's bindless handle changes once the new image is
+	* ready. The old image and handle go through the deletion queue, frames recorded before the switch
+	* keep sampling them. Look the handle up every frame with getBindlessHandle(); until the first
+	* upload has finished it returns the handle of a 1 x 1 white fallback texture.
+	*/
+	class MgeTextureManager
+	{
+	public:
+		using Loader = std::function<MgeTextureData()>;
+
+		// Runs on the loader thread
+		using LoadedCallback = std::function<void()>;
+
+		struct Stats
+		{
+			uint32_t textureCount = 0;
+			uint32_t residentCount = 0;		// Textures with an image, at any level
+			uint32_t pendingLoads = 0;		// Queued or running on the loader thread
+			VkDeviceSize residentBytes = 0;
+			VkDeviceSize budgetBytes = 0;
+			unsigned long long streamedIn = 0;	// Images built from system memory (first uploads included)
+			unsigned long long streamedOut = 0;	// Images shrunk to fit the budget
+			VkDeviceSize uploadedBytes = 0;
+		};
+
+		MgeTextureManager() = default;
+
+		MgeTextureManager(const MgeTextureManager&) = delete;
+		MgeTextureManager& operator=(const MgeTextureManager&) = delete;
+
+		void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, MgeAllocator& memoryAllocator, MgeBindlessTable& bindlessTable,
+			VkQueue graphicsQueue, unsigned int graphicsQueueFamily, VkDeviceSize budgetBytes);
+
+		// Only called once the device is idle
+		void destroy();
+
+		// Returns right away, the texture shows the fallback until its data is loaded and uploaded
+		MgeTextureId load(Loader loader);
+
+		// Called on the loader thread whenever a load has finished or failed, set before the first load()
+		void setLoadedCallback(LoadedCallback callback) { loadedCallback = std::move(callback); }
+
+		/*
+		* Loaded data, uploads, streaming or requests changing a texture's wanted level that the next
+		* update() still has to deal with. Loads still on the loader thread do not count.
+		*/
+		bool hasPendingWork() const;
+
+		// The texture is drawn this frame, covering about screenSize pixels across
+		void request(MgeTextureId texture, float screenSize);
+
+		// Retires finished uploads, starts new ones and balances residency. Replaced images are
+		// destroyed once lastSubmission has completed.
+		void update(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission);
+
+		uint32_t getBindlessHandle(MgeTextureId texture) const;
+
+		uint32_t getFallbackHandle() const { return fallbackHandle; }
+
+		Stats getStats() const;
+
+	private:
+		static const VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+		static const uint32_t TEXEL_SIZE = 4;
+
+		static const uint32_t MIP_TAIL_SIZE = 32;		// Levels this size and below are always resident
+		static const VkDeviceSize MAX_UPDATE_UPLOAD_BYTES = 2ull * 1024 * 1024;	// Staging per update(), copied on the render thread
+		static const VkDeviceSize STAGING_RING_SIZE = 8ull * 1024 * 1024;		// A few updates' worth in flight
+		static const VkDeviceSize STAGING_ALIGNMENT = 16;
+		static const unsigned long long RECENT_FRAMES = 2;	// Requested this recently still counts as in use
+		static const VkDeviceSize LOW_WATER_PERCENT = 90;	// Share of the budget streaming out goes down to and streaming in stays under
+
+		struct Texture
+		{
+			bool loaded = false;
+			MgeTextureData data;
+			uint32_t mipCount = 0;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			MgeAllocation allocation;
+			uint32_t residentMip = 0;		// First level held by image
+			uint32_t handle = MGE_INVALID_BINDLESS_HANDLE;
+
+			float screenSize = 0.0f;
+			unsigned long long lastUsed = 0;	// update() count of the last request()
+			bool streaming = false;				// A replacement image is being built
+			uint32_t balancedMip = 0;			// Wanted level as of the end of the last update()
+		};
+
+		// A texture's new image, swapped in once its submission has finished
+		struct Replacement
+		{
+			MgeTextureId texture = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			MgeAllocation allocation;
+			uint32_t residentMip = 0;
+		};
+
+		struct Submission
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			unsigned long long serial = 0;
+
+			VkDeviceSize stagingRingBytes = 0;	// Ring space (padding included) used by the submission
+			std::vector<std::pair<VkBuffer, MgeAllocation>> stagingBuffers;	// Uploads larger than the ring
+			std::vector<Replacement> replacements;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		MgeAllocator* allocator = nullptr;
+		MgeBindlessTable* bindless = nullptr;
+
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		VkBuffer stagingRing = VK_NULL_HANDLE;
+		MgeAllocation stagingRingAllocation;
+		VkDeviceSize stagingHead = 0;
+		VkDeviceSize stagingUsed = 0;
+
+		VkDeviceSize budget = 0;
+		VkDeviceSize residentBytes = 0;		// Newest image of every texture, an image being replaced no longer counts
+
+		std::vector<Texture> textures;
+		std::deque<MgeTextureId> waitingUploads;	// Loaded, first upload not recorded yet
+
+		Texture fallback;
+		uint32_t fallbackHandle = MGE_INVALID_BINDLESS_HANDLE;
+
+		unsigned long long frame = 1;	// Counts update() calls, a lastUsed of 0 means never requested
+
+		bool recording = false;
+		Submission currentSubmission;
+		VkDeviceSize updateUploadBytes = 0;
+
+		std::deque<Submission> pendingSubmissions;	// Oldest first
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		unsigned long long submittedSerial = 0;
+
+		unsigned long long streamedIn = 0;
+		unsigned long long streamedOut = 0;
+		VkDeviceSize uploadedBytes = 0;
+
+		// Loader thread
+		std::thread loaderThread;
+		mutable std::mutex loaderMutex;
+		std::condition_variable loadAvailable;
+		std::deque<std::pair<MgeTextureId, Loader>> loadQueue;
+		std::vector<std::pair<MgeTextureId, MgeTextureData>> loadedTextures;
+		uint32_t pendingLoads = 0;
+		bool stopping = false;
+		std::exception_ptr loaderError;
+		LoadedCallback loadedCallback;
+
+		void loaderLoop();
+
+		void retireSubmissions(MgeDeletionQueue& deletionQueue, unsigned long long lastSubmission);
+
+		void balanceResidency();
+
+		// Records a new image holding levels residentMip .. mipCount - 1 built from system memory
+		Replacement recordStreamIn(Texture& texture, uint32_t residentMip);
+
+		// Records a new image holding levels residentMip .. mipCount - 1 copied from the current image
+		Replacement recordStreamOut(Texture& texture, uint32_t residentMip);
+
+		void createImage(uint32_t width, uint32_t height, uint32_t mipCount, Replacement& replacement);
+
+		// Whether recordStreamIn() can stage size bytes right now
+		bool hasStagingSpace(VkDeviceSize size) const;
+
+		bool findStagingSpace(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed) const;
+
+		// Takes ring space for the current submission, false when it does not fit
+		bool reserveStaging(VkDeviceSize size, VkDeviceSize& offset);
+
+		static VkImageCreateInfo getImageInfo(uint32_t width, uint32_t height, uint32_t mipCount);
+
+		// Device memory an image holding levels residentMip .. mipCount - 1 takes, without creating it
+		VkDeviceSize getImageBytes(const Texture& texture, uint32_t residentMip) const;
+
+		void transitionLevels(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+		void beginSubmission();
+
+		void submit();
+
+		// Level a texture needs for its requested size, or its mip tail when it has not been drawn lately
+		uint32_t getWantedMip(const Texture& texture) const;
+
+		uint32_t getTailMip(const Texture& texture) const;
+
+		// Tightly packed size of levels firstLevel .. endLevel - 1
+		VkDeviceSize getLevelBytes(const Texture& texture, uint32_t firstLevel, uint32_t endLevel) const;
+
+		unsigned long long getCompletedSerial();
+	};
+}
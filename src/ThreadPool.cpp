@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+#include <stdexcept>
+
+namespace mge {
+
+	MgeThreadPool::~MgeThreadPool()
+	{
+		stop();
+	}
+
+	void MgeThreadPool::start(unsigned int workerCount)
+	{
+		stop();
+
+		stopping = false;
+
+		for (unsigned int i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&MgeThreadPool::workerLoop, this, i);
+		}
+	}
+
+	void MgeThreadPool::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		workAvailable.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		workers.clear();
+	}
+
+	void MgeThreadPool::run(unsigned int taskCount, const Task& task)
+	{
+		if (taskCount > workers.size())
+		{
+			throw std::runtime_error("Thread pool has fewer workers than tasks!");
+		}
+
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		currentTask = &task;
+		currentTaskCount = taskCount;
+		remainingTasks = taskCount;
+		generation++;
+
+		workAvailable.notify_all();
+
+		workDone.wait(lock, [this]() { return remainingTasks == 0; });
+
+		currentTask = nullptr;
+
+		if (firstError)
+		{
+			std::exception_ptr error = firstError;
+			firstError = nullptr;
+
+			std::rethrow_exception(error);
+		}
+	}
+
+	void MgeThreadPool::workerLoop(unsigned int workerIndex)
+	{
+		unsigned long long seenGeneration = 0;
+
+		while (true)
+		{
+			const Task* task = nullptr;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+
+				if (stopping)
+				{
+					return;
+				}
+
+				seenGeneration = generation;
+
+				if (workerIndex < currentTaskCount)
+				{
+					task = currentTask;
+				}
+			}
+
+			// Workers without a task this round go straight back to sleep
+			if (task == nullptr)
+			{
+				continue;
+			}
+
+			std::exception_ptr error;
+
+			try
+			{
+				(*task)(workerIndex);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (error && !firstError)
+				{
+					firstError = error;
+				}
+
+				remainingTasks--;
+			}
+
+			workDone.notify_one();
+		}
+	}
+}
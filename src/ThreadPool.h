@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mge {
+
+	/*
+	* Fixed-size worker thread pool
+	*
+	* Built for fork / join work inside a frame, for example recording one slice of the draw list per
+	* worker. run(taskCount, task) hands task index t to worker t (t < workerCount), so a worker always
+	* gets the same task index and can use resources it owns without locking, then blocks until every
+	* task has finished.
+	*
+	* The workers stay alive between calls and sleep on a condition variable while idle.
+	*/
+	class MgeThreadPool
+	{
+	public:
+		using Task = std::function<void(unsigned int taskIndex)>;
+
+		MgeThreadPool() = default;
+
+		MgeThreadPool(const MgeThreadPool&) = delete;
+		MgeThreadPool& operator=(const MgeThreadPool&) = delete;
+
+		~MgeThreadPool();
+
+		void start(unsigned int workerCount);
+
+		void stop();
+
+		unsigned int getWorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+		// Runs tasks 0 .. taskCount - 1 (taskCount <= worker count) and waits for all of them.
+		// An exception thrown by a task is rethrown here once every task has finished.
+		void run(unsigned int taskCount, const Task& task);
+
+	private:
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workDone;
+
+		const Task* currentTask = nullptr;
+		unsigned int currentTaskCount = 0;
+		unsigned int remainingTasks = 0;
+		unsigned long long generation = 0;
+		bool stopping = false;
+
+		std::exception_ptr firstError;
+
+		void workerLoop(unsigned int workerIndex);
+	};
+}
@@ -0,0 +1,73 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeUniformRing::init(VkPhysicalDevice physicalDevice, MgeAllocator& memoryAllocator, unsigned int slotCount, VkDeviceSize bytesPerSlot)
+	{
+		allocator = &memoryAllocator;
+		slots = slotCount;
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		// Dynamic offsets have to be multiples of this (a power of two)
+		alignment = std::max<VkDeviceSize>(deviceProperties.limits.minUniformBufferOffsetAlignment, 16);
+
+		// Rounded up so every region starts on an aligned offset
+		slotSize = (bytesPerSlot + alignment - 1) & ~(alignment - 1);
+
+		allocator->createBuffer(slotSize * slots, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, allocation);
+
+		if (allocation.mapped == nullptr)
+		{
+			throw std::runtime_error("Failed to map uniform ring buffer!");
+		}
+
+		currentSlot = 0;
+		head = 0;
+	}
+
+	void MgeUniformRing::destroy()
+	{
+		// Only called once the device is idle
+		if (buffer != VK_NULL_HANDLE)
+		{
+			allocator->destroyBuffer(buffer, allocation);
+			buffer = VK_NULL_HANDLE;
+		}
+	}
+
+	void MgeUniformRing::beginFrame(unsigned int slot)
+	{
+		if (slot >= slots)
+		{
+			throw std::runtime_error("Uniform ring slot out of range!");
+		}
+
+		currentSlot = slot;
+		head = getSlotOffset(slot);
+	}
+
+	MgeUniformRing::Allocation MgeUniformRing::allocate(VkDeviceSize size)
+	{
+		VkDeviceSize end = getSlotOffset(currentSlot) + slotSize;
+
+		// Never spills into the next slot, its region may still be read by the GPU
+		if (head + size > end)
+		{
+			throw std::runtime_error("Uniform ring slot is full!");
+		}
+
+		Allocation result;
+		result.data = static_cast<char*>(allocation.mapped) + head;
+		result.offset = static_cast<uint32_t>(head);
+
+		head = std::min(end, (head + size + alignment - 1) & ~(alignment - 1));
+
+		return result;
+	}
+}
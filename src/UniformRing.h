@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "MemoryAllocator.h"
+
+namespace mge {
+
+	/*
+	* Dynamic uniform buffer ring
+	*
+	* One persistently mapped, host coherent buffer split into a region per slot. Each slot belongs to
+	* one submission that can be in flight at the same time (the same slots the GPU profiler uses), and
+	* allocations inside a region are bumped forward and aligned to minUniformBufferOffsetAlignment:
+	*
+	*     ring.beginFrame(slot);                       // slot's previous submission has finished
+	*     uint32_t offset = ring.push(cameraData);     // memcpy straight into mapped memory
+	*     vkCmdBindDescriptorSets(..., 1, &offset);    // one descriptor, dynamic offset per bind
+	*
+	* The descriptor set points at the whole buffer once, so per-frame data costs a memcpy and a dynamic
+	* offset. There is no map / unmap, no flush and no allocation after init.
+	*/
+	class MgeUniformRing
+	{
+	public:
+		struct Allocation
+		{
+			void* data = nullptr;	// Mapped pointer, write the uniform data here
+			uint32_t offset = 0;	// Dynamic offset into the buffer
+		};
+
+		void init(VkPhysicalDevice physicalDevice, MgeAllocator& memoryAllocator, unsigned int slotCount, VkDeviceSize bytesPerSlot);
+
+		void destroy();
+
+		// Starts the slot's region over. Only call once the slot's previous submission is known to be complete.
+		void beginFrame(unsigned int slot);
+
+		Allocation allocate(VkDeviceSize size);
+
+		template<typename T>
+		uint32_t push(const T& data)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			std::memcpy(allocation.data, &data, sizeof(T));
+
+			return allocation.offset;
+		}
+
+		// Offset of the slot's first allocation, which pre-recorded command buffers can bake in
+		uint32_t getSlotOffset(unsigned int slot) const { return static_cast<uint32_t>(slot * slotSize); }
+
+		VkBuffer getBuffer() const { return buffer; }
+
+		// Bytes used in the current slot, padding included
+		VkDeviceSize getUsedBytes() const { return head - getSlotOffset(currentSlot); }
+
+	private:
+		MgeAllocator* allocator = nullptr;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MgeAllocation allocation;
+
+		VkDeviceSize alignment = 256;
+		VkDeviceSize slotSize = 0;
+		unsigned int slots = 0;
+
+		unsigned int currentSlot = 0;
+		VkDeviceSize head = 0;
+	};
+}
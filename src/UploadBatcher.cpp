@@ -0,0 +1,479 @@
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace mge {
+
+	void MgeUploadBatcher::init(VkDevice logicalDevice, MgeAllocator& memoryAllocator,
+		VkQueue transferQueue, unsigned int transferQueueFamily,
+		VkQueue graphicsQueue, unsigned int graphicsQueueFamily,
+		VkDeviceSize size)
+	{
+		device = logicalDevice;
+		allocator = &memoryAllocator;
+		uploadQueue = transferQueue;
+		uploadFamily = transferQueueFamily;
+		acquireQueue = graphicsQueue;
+		acquireFamily = graphicsQueueFamily;
+		ownershipTransfer = transferQueueFamily != graphicsQueueFamily;
+		ringSize = size;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = uploadFamily;
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload command pool!");
+		}
+
+		if (ownershipTransfer)
+		{
+			poolInfo.queueFamilyIndex = acquireFamily;
+
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &acquireCommandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create upload acquire command pool!");
+			}
+		}
+
+		uploadTimeline = createTimeline();
+
+		if (ownershipTransfer)
+		{
+			acquireTimeline = createTimeline();
+		}
+
+		allocator->createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringBuffer, ringAllocation);
+	}
+
+	void MgeUploadBatcher::destroy()
+	{
+		// Only called once the device is idle, every batch has finished
+		if (recording)
+		{
+			vkEndCommandBuffer(currentBatch.commandBuffer);
+			recording = false;
+		}
+
+		pendingBatches.clear();
+		acquiringBatches.clear();
+		freeBatches.clear();
+
+		if (ringBuffer != VK_NULL_HANDLE)
+		{
+			allocator->destroyBuffer(ringBuffer, ringAllocation);
+		}
+
+		vkDestroySemaphore(device, uploadTimeline, nullptr);
+		uploadTimeline = VK_NULL_HANDLE;
+
+		if (acquireTimeline != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(device, acquireTimeline, nullptr);
+			acquireTimeline = VK_NULL_HANDLE;
+		}
+
+		// Destroying the pools frees the command buffers
+		vkDestroyCommandPool(device, commandPool, nullptr);
+		commandPool = VK_NULL_HANDLE;
+
+		if (acquireCommandPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device, acquireCommandPool, nullptr);
+			acquireCommandPool = VK_NULL_HANDLE;
+		}
+	}
+
+	void MgeUploadBatcher::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		const char* source = static_cast<const char*>(data);
+
+		while (size > 0)
+		{
+			VkDeviceSize chunk = std::min(size, ringSize);
+			VkDeviceSize offset;
+
+			// Ring full: submit what is recorded and wait for the oldest batch to give space back
+			while (!reserve(chunk, offset))
+			{
+				if (recording)
+				{
+					flush();
+				}
+
+				retireOldest();
+			}
+
+			std::memcpy(static_cast<char*>(ringAllocation.mapped) + offset, source, static_cast<size_t>(chunk));
+
+			if (!recording)
+			{
+				beginBatch();
+			}
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = offset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = chunk;
+			vkCmdCopyBuffer(currentBatch.commandBuffer, ringBuffer, dstBuffer, 1, &copyRegion);
+
+			if (ownershipTransfer)
+			{
+				// Filled in for release in flush() and for acquire in submitAcquire()
+				VkBufferMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcQueueFamilyIndex = uploadFamily;
+				barrier.dstQueueFamilyIndex = acquireFamily;
+				barrier.buffer = dstBuffer;
+				barrier.offset = dstOffset;
+				barrier.size = chunk;
+
+				currentBatch.ownershipBarriers.push_back(barrier);
+			}
+
+			source += chunk;
+			dstOffset += chunk;
+			size -= chunk;
+
+			uploadedBytes += chunk;
+		}
+
+		uploadCount++;
+	}
+
+	unsigned long long MgeUploadBatcher::flush()
+	{
+		if (!recording)
+		{
+			return submittedBatch;
+		}
+
+		if (ownershipTransfer)
+		{
+			// Release the written ranges to the graphics family, the acquire half follows on that queue
+			for (auto& barrier : currentBatch.ownershipBarriers)
+			{
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+			}
+
+			vkCmdPipelineBarrier(currentBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, static_cast<unsigned int>(currentBatch.ownershipBarriers.size()), currentBatch.ownershipBarriers.data(), 0, nullptr);
+		}
+		else
+		{
+			// Make the copies visible to anything submitted to the queue after this batch
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+			vkCmdPipelineBarrier(currentBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(currentBatch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record upload command buffer!");
+		}
+
+		currentBatch.serial = submittedBatch + 1;
+
+		uint64_t signalValue = currentBatch.serial;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &currentBatch.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &uploadTimeline;
+
+		if (vkQueueSubmit(uploadQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload batch!");
+		}
+
+		submittedBatch = currentBatch.serial;
+		pendingBatches.push_back(currentBatch);
+
+		currentBatch = Batch{};
+		recording = false;
+
+		return submittedBatch;
+	}
+
+	void MgeUploadBatcher::collect()
+	{
+		unsigned long long uploaded = getTimelineValue(uploadTimeline);
+
+		while (!pendingBatches.empty() && pendingBatches.front().serial <= uploaded)
+		{
+			retireOldest();
+		}
+
+		if (acquiringBatches.empty())
+		{
+			return;
+		}
+
+		// Acquire command buffers can be reused once the graphics queue is through them
+		unsigned long long acquired = getTimelineValue(acquireTimeline);
+
+		while (!acquiringBatches.empty() && acquiringBatches.front().serial <= acquired)
+		{
+			freeBatches.push_back(acquiringBatches.front());
+			acquiringBatches.pop_front();
+		}
+	}
+
+	bool MgeUploadBatcher::isAvailable(unsigned long long batch)
+	{
+		// On the graphics queue itself, submission order alone makes the data visible
+		if (!ownershipTransfer)
+		{
+			return batch <= submittedBatch;
+		}
+
+		collect();
+
+		return batch <= completedBatch;
+	}
+
+	void MgeUploadBatcher::makeAvailable(unsigned long long batch)
+	{
+		if (!ownershipTransfer)
+		{
+			return;
+		}
+
+		while (completedBatch < batch && !pendingBatches.empty())
+		{
+			retireOldest();
+		}
+	}
+
+	bool MgeUploadBatcher::reserve(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		// An empty ring can start over at the front, no wrap padding needed
+		if (ringUsed == 0)
+		{
+			ringHead = 0;
+		}
+
+		VkDeviceSize aligned = (ringHead + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+		VkDeviceSize consumed;
+
+		if (aligned + size <= ringSize)
+		{
+			offset = aligned;
+			consumed = aligned + size - ringHead;
+		}
+		else
+		{
+			// Does not fit before the end, skip the tail of the ring and start at 0
+			offset = 0;
+			consumed = ringSize - ringHead + size;
+		}
+
+		if (ringUsed + consumed > ringSize)
+		{
+			return false;
+		}
+
+		ringHead = (offset + size) % ringSize;
+		ringUsed += consumed;
+		currentBatch.ringBytes += consumed;
+
+		return true;
+	}
+
+	void MgeUploadBatcher::beginBatch()
+	{
+		VkDeviceSize ringBytes = currentBatch.ringBytes;	// Space reserved for the first copy already counts
+
+		if (!freeBatches.empty())
+		{
+			currentBatch = freeBatches.back();
+			freeBatches.pop_back();
+
+			vkResetCommandBuffer(currentBatch.commandBuffer, 0);
+
+			currentBatch.ownershipBarriers.clear();
+		}
+		else
+		{
+			currentBatch = Batch{};
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &currentBatch.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate upload command buffer!");
+			}
+
+			if (ownershipTransfer)
+			{
+				allocInfo.commandPool = acquireCommandPool;
+
+				if (vkAllocateCommandBuffers(device, &allocInfo, &currentBatch.acquireCommandBuffer) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to allocate upload acquire command buffer!");
+				}
+			}
+		}
+
+		currentBatch.ringBytes = ringBytes;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(currentBatch.commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin upload command buffer!");
+		}
+
+		recording = true;
+	}
+
+	void MgeUploadBatcher::retireOldest()
+	{
+		if (pendingBatches.empty())
+		{
+			throw std::runtime_error("Upload ring is full but no batch is in flight!");
+		}
+
+		Batch batch = pendingBatches.front();
+		pendingBatches.pop_front();
+
+		uint64_t waitValue = batch.serial;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &uploadTimeline;
+		waitInfo.pValues = &waitValue;
+
+		if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait for upload batch!");
+		}
+
+		// Only the copies read the ring, so its space is free as soon as they are done
+		ringUsed -= batch.ringBytes;
+		completedBatch = batch.serial;
+
+		batch.ringBytes = 0;
+
+		if (ownershipTransfer)
+		{
+			submitAcquire(batch);
+			acquiringBatches.push_back(batch);
+		}
+		else
+		{
+			freeBatches.push_back(batch);
+		}
+	}
+
+	void MgeUploadBatcher::submitAcquire(Batch& batch)
+	{
+		vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin upload acquire command buffer!");
+		}
+
+		// Matching acquire half of the release barriers, for any kind of read by later graphics work
+		for (auto& barrier : batch.ownershipBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(batch.acquireCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 0, nullptr, static_cast<unsigned int>(batch.ownershipBarriers.size()), batch.ownershipBarriers.data(), 0, nullptr);
+
+		if (vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record upload acquire command buffer!");
+		}
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		uint64_t waitValue = batch.serial;
+		uint64_t signalValue = batch.serial;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &waitValue;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &uploadTimeline;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &acquireTimeline;
+
+		if (vkQueueSubmit(acquireQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload acquire!");
+		}
+	}
+
+	VkSemaphore MgeUploadBatcher::createTimeline()
+	{
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &timelineInfo;
+
+		VkSemaphore timeline;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload timeline semaphore!");
+		}
+
+		return timeline;
+	}
+
+	unsigned long long MgeUploadBatcher::getTimelineValue(VkSemaphore timeline)
+	{
+		uint64_t value = 0;
+
+		vkGetSemaphoreCounterValue(device, timeline, &value);
+
+		return value;
+	}
+}
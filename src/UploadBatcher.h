@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+
+#include "MemoryAllocator.h"
+
+namespace mge {
+
+	/*
+	* Staging ring buffer + upload batcher
+	*
+	* Uploads are copied into a persistently mapped ring buffer and the matching vkCmdCopyBuffer is
+	* recorded into the current batch. Nothing is submitted until flush(), so thousands of uploads
+	* end up in a single submission:
+	*
+	*     uploader.uploadBuffer(vertexBuffer, 0, vertices.data(), vertexSize);
+	*     uploader.uploadBuffer(indexBuffer, 0, indices.data(), indexSize);
+	*     unsigned long long batch = uploader.flush();
+	*
+	* Batches signal an upload timeline semaphore with their serial. collect() reads its counter and
+	* gives the ring space of finished batches back, nothing ever waits for a whole queue.
+	*
+	* When the device has a dedicated transfer (or async compute) queue family, batches run there
+	* and do not take time away from rendering:
+	*
+	*   - the batch ends with queue family release barriers (transfer -> graphics) for every range it
+	*     wrote,
+	*   - once the upload timeline shows the copies are done, a small acquire command buffer is
+	*     submitted to the graphics queue. It waits on the upload timeline for the batch's serial
+	*     (already reached, so the graphics queue never stalls), records the matching acquire
+	*     barriers and signals the acquire timeline, which tells when it can be reused.
+	*
+	* Without such a family everything runs on the graphics queue and each batch ends with a plain
+	* memory barrier instead.
+	*
+	* Either way, graphics submissions made after isAvailable(batch) returns true may use the data.
+	* makeAvailable(batch) waits for that point, for data that is needed right away.
+	*/
+	class MgeUploadBatcher
+	{
+	public:
+		void init(VkDevice logicalDevice, MgeAllocator& memoryAllocator,
+			VkQueue transferQueue, unsigned int transferQueueFamily,
+			VkQueue graphicsQueue, unsigned int graphicsQueueFamily,
+			VkDeviceSize ringSize = 16ull * 1024 * 1024);
+
+		void destroy();
+
+		bool usesDedicatedQueue() const { return ownershipTransfer; }
+
+		// Copies data into the ring and records the copy. Uploads larger than the ring are split.
+		void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+		// Submits the current batch, returns its serial (or the last serial when there was nothing to submit)
+		unsigned long long flush();
+
+		// Retires finished batches and hands them over to the graphics queue, never blocks
+		void collect();
+
+		bool isAvailable(unsigned long long batch);
+
+		// Waits on the upload timeline for the batches up to this one only
+		void makeAvailable(unsigned long long batch);
+
+		unsigned long long getUploadCount() const { return uploadCount; }
+		VkDeviceSize getUploadedBytes() const { return uploadedBytes; }
+		unsigned long long getBatchCount() const { return submittedBatch; }
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkDeviceSize ringBytes = 0;		// Ring space (padding included) used by the batch
+			unsigned long long serial = 0;
+
+			// Dedicated transfer queue only
+			VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+			std::vector<VkBufferMemoryBarrier> ownershipBarriers;
+		};
+
+		static const VkDeviceSize RING_ALIGNMENT = 16;
+
+		VkDevice device = VK_NULL_HANDLE;
+		MgeAllocator* allocator = nullptr;
+
+		VkQueue uploadQueue = VK_NULL_HANDLE;
+		unsigned int uploadFamily = 0;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		// Both count batch serials
+		VkSemaphore uploadTimeline = VK_NULL_HANDLE;
+		VkSemaphore acquireTimeline = VK_NULL_HANDLE;
+
+		// Receiving side of ownership transfers
+		bool ownershipTransfer = false;
+		VkQueue acquireQueue = VK_NULL_HANDLE;
+		unsigned int acquireFamily = 0;
+		VkCommandPool acquireCommandPool = VK_NULL_HANDLE;
+
+		VkBuffer ringBuffer = VK_NULL_HANDLE;
+		MgeAllocation ringAllocation;
+		VkDeviceSize ringSize = 0;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringUsed = 0;
+
+		bool recording = false;
+		Batch currentBatch;
+
+		std::deque<Batch> pendingBatches;	// Submitted, copies possibly still running, oldest first
+		std::deque<Batch> acquiringBatches;	// Copies done, acquire submitted to the graphics queue
+		std::vector<Batch> freeBatches;		// Finished, ready for reuse
+
+		unsigned long long submittedBatch = 0;
+		unsigned long long completedBatch = 0;
+
+		unsigned long long uploadCount = 0;
+		VkDeviceSize uploadedBytes = 0;
+
+		bool reserve(VkDeviceSize size, VkDeviceSize& offset);
+
+		void beginBatch();
+
+		void retireOldest();
+
+		void submitAcquire(Batch& batch);
+
+		VkSemaphore createTimeline();
+
+		unsigned long long getTimelineValue(VkSemaphore timeline);
+	};
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <GLM/glm.hpp>
+#include <GLM/gtc/packing.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mge {
+
+	/*
+	* Packed attribute types
+	*
+	* Plain wrappers around the packed bits, so the format of a field follows from its C++ type. The
+	* input assembler unpacks them back to floats, the shaders keep reading vec2 / vec3 / vec4.
+	*/
+
+	// Two half floats, R16G16_SFLOAT (4 bytes instead of 8 for a vec2)
+	struct MgeHalf2
+	{
+		uint32_t bits = 0;
+
+		static MgeHalf2 pack(const glm::vec2& value) { return { glm::packHalf2x16(value) }; }
+	};
+
+	// Four bytes mapped to 0..1, R8G8B8A8_UNORM (4 bytes instead of 16 for a vec4 color)
+	struct MgeUnorm8x4
+	{
+		uint32_t bits = 0;
+
+		static MgeUnorm8x4 pack(const glm::vec4& value) { return { glm::packUnorm4x8(value) }; }
+	};
+
+	// Three 10 bit components mapped to -1..1 plus 2 bits of w, A2B10G10R10_SNORM_PACK32 (normals, tangents)
+	struct MgeSnorm10x3
+	{
+		uint32_t bits = 0;
+
+		static MgeSnorm10x3 pack(const glm::vec4& value) { return { glm::packSnorm3x10_1x2(value) }; }
+	};
+
+	// Vertex format of each attribute type, a type without a specialization can not be used in a layout
+	template<typename T>
+	struct MgeAttributeFormat;
+
+	template<> struct MgeAttributeFormat<float> { static constexpr VkFormat format = VK_FORMAT_R32_SFLOAT; };
+	template<> struct MgeAttributeFormat<glm::vec2> { static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT; };
+	template<> struct MgeAttributeFormat<glm::vec3> { static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT; };
+	template<> struct MgeAttributeFormat<glm::vec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+	template<> struct MgeAttributeFormat<MgeHalf2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT; };
+	template<> struct MgeAttributeFormat<MgeUnorm8x4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; };
+	template<> struct MgeAttributeFormat<MgeSnorm10x3> { static constexpr VkFormat format = VK_FORMAT_A2B10G10R10_SNORM_PACK32; };
+
+	// One field of a vertex struct, declared with MGE_VERTEX_FIELD
+	template<typename T, uint32_t Offset>
+	struct MgeVertexField
+	{
+		using Type = T;
+
+		static constexpr uint32_t offset = Offset;
+		static constexpr VkFormat format = MgeAttributeFormat<T>::format;
+	};
+
+	#define MGE_VERTEX_FIELD(VertexType, member) \
+		::mge::MgeVertexField<decltype(VertexType::member), static_cast<uint32_t>(offsetof(VertexType, member))>
+
+	/*
+	* Vertex layout reflection
+	*
+	* The binding and attribute descriptions of a vertex type are generated at compile time from its
+	* field list, so the formats, offsets and stride can not drift away from the struct:
+	*
+	*     struct Vertex
+	*     {
+	*         glm::vec2 pos;
+	*         glm::vec3 color;
+	*     };
+	*
+	*     using VertexLayout = MgeVertexLayout<Vertex, VK_VERTEX_INPUT_RATE_VERTEX,
+	*         MGE_VERTEX_FIELD(Vertex, pos), MGE_VERTEX_FIELD(Vertex, color)>;
+	*
+	*     auto binding = VertexLayout::getBindingDescription(0);
+	*     auto attributes = VertexLayout::getAttributeDescriptions(0, 0);	// locations 0, 1
+	*
+	* The layout has to be declared after the struct is complete (offsetof and sizeof need it).
+	* Fields get consecutive shader locations in the order they are listed, starting at firstLocation.
+	* Every vertex type has its own layout, so any number of them can be used side by side.
+	*/
+	template<typename VertexType, VkVertexInputRate InputRate, typename... Fields>
+	struct MgeVertexLayout
+	{
+		static constexpr uint32_t stride = sizeof(VertexType);
+		static constexpr uint32_t attributeCount = sizeof...(Fields);
+
+		static_assert(sizeof...(Fields) > 0, "A vertex layout needs at least one field");
+		static_assert(((Fields::offset + sizeof(typename Fields::Type) <= sizeof(VertexType)) && ...), "Vertex field outside of the vertex");
+
+		static constexpr VkVertexInputBindingDescription getBindingDescription(uint32_t binding)
+		{
+			VkVertexInputBindingDescription bindingDescription{};
+			bindingDescription.binding = binding;
+			bindingDescription.stride = stride;
+			bindingDescription.inputRate = InputRate;
+
+			return bindingDescription;
+		}
+
+		static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Fields)> getAttributeDescriptions(uint32_t binding, uint32_t firstLocation)
+		{
+			uint32_t location = firstLocation;
+
+			// Braced initializers are evaluated left to right, so the locations follow the field order
+			return { VkVertexInputAttributeDescription{ location++, binding, Fields::format, Fields::offset }... };
+		}
+	};
+}
@@ -16,6 +16,11 @@ namespace mge {
 		windowName = name;
 	}
 
+	MgeEngine::MgeEngine(int w, int h, std::string name, const MgeEngineConfig& engineConfig) : width{ w }, height{ h }, windowName{ name }, config{ engineConfig }
+	{
+		frameLimiter.setFrameRate(config.frameRateCap);
+	}
+
 	int MgeEngine::initWindow()
 	{
 
@@ -44,6 +49,8 @@ namespace mge {
 
 		glfwSetWindowUserPointer(mainWindow, this);
 		glfwSetFramebufferSizeCallback(mainWindow, frameBufferResizeCallback);
+		glfwSetKeyCallback(mainWindow, keyCallback);
+		glfwSetWindowRefreshCallback(mainWindow, windowRefreshCallback);
 
 
 		return EXIT_SUCCESS;
@@ -84,30 +91,325 @@ namespace mge {
 	{
 		auto app = reinterpret_cast<MgeEngine*>(glfwGetWindowUserPointer(window));
 		app->frameBufferResize = true;
+		app->redrawRequested = true;
+	}
+
+	void MgeEngine::windowRefreshCallback(GLFWwindow* window)
+	{
+		// Uncovered or damaged, the contents have to be drawn again
+		auto app = reinterpret_cast<MgeEngine*>(glfwGetWindowUserPointer(window));
+		app->redrawRequested = true;
+	}
+
+	void MgeEngine::keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+	{
+		auto app = reinterpret_cast<MgeEngine*>(glfwGetWindowUserPointer(window));
+		app->redrawRequested = true;
+
+		if (key != GLFW_KEY_P || action != GLFW_PRESS)
+		{
+			return;
+		}
+
+		switch (app->getPresentProfile())
+		{
+		case MgePresentProfile::Default: app->setPresentProfile(MgePresentProfile::LowLatency); break;
+		case MgePresentProfile::LowLatency: app->setPresentProfile(MgePresentProfile::Throughput); break;
+		default: app->setPresentProfile(MgePresentProfile::Default); break;
+		}
 	}
 
 	void MgeEngine::mainLoop()
 	{
+		auto startTime = std::chrono::steady_clock::now();
 
-		while (!getShouldClose())
+		if (config.threadScaling)
+		{
+			runThreadScaling();
+		}
+		else if (config.instanceStress)
+		{
+			runInstanceStress();
+		}
+		else
 		{
-			glfwPollEvents();
+			benchmark.configure(config.benchmarkWarmupFrames, config.benchmarkFrames);
 
-			drawFrame();
+			runFrames();
 		}
 
 		vkDeviceWaitIdle(device);  // Need to do this. Even after the while loop finished, the drawing could still going on.
 
+		if (!config.threadScaling && !config.instanceStress && benchmark.isFinished())
+		{
+			reportBenchmark(config.benchmarkReport);
+		}
+
+		if (config.headless)
+		{
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+			std::cout << "Headless: rendered " << framesRendered << " frames in " << elapsed.count() << " s ("
+				<< (elapsed.count() > 0.0 ? framesRendered / elapsed.count() : 0.0) << " fps)" << std::endl;
+		}
+
+		if (config.renderOnDemand)
+		{
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+			std::cout << "On demand: rendered " << framesRendered << " frames in " << elapsed.count() << " s, "
+				<< idleWakeups << " wake-ups with nothing to draw" << std::endl;
+		}
+	}
+
+	void MgeEngine::runFrames()
+	{
+		while (!getShouldClose())
+		{
+			if (config.renderOnDemand && !waitForRedraw())
+			{
+				continue;
+			}
+
+			benchmark.beginFrame();
+
+			// Time spent held back is not part of the frame
+			paceFrame();
+
+			auto frameStart = MgeBenchmark::Clock::now();
+
+			// Input is sampled inside drawFrame(), once the frame no longer has anything to wait for
+			if (pendingPresentProfile.has_value())
+			{
+				applyPresentProfile();
+			}
+
+			// Nothing was rendered when the swapchain had to be recreated first, that is not a frame
+			if (drawFrame())
+			{
+				benchmark.addSample("cpu_frame_ms", MgeBenchmark::millisecondsSince(frameStart));
+				benchmark.endFrame();
+			}
+		}
+	}
+
+	void MgeEngine::paceFrame()
+	{
+		if (!frameLimiter.isEnabled())
+		{
+			return;
+		}
+
+		/*
+		* With a cap the display, not the CPU, should set the pace. Wait until every present but the
+		* newest has reached the screen, so at most one finished frame is ever queued ahead of the one
+		* on screen and the CPU does not render frames MAILBOX would just replace.
+		*/
+		if (presentWaitEnabled && pendingPresents.size() > 1)
+		{
+			auto presentWaitStart = MgeBenchmark::Clock::now();
+
+			// A timeout or an out of date swapchain is dealt with by the next frame
+			waitForPresent(device, swapChain, pendingPresents[pendingPresents.size() - 2].id, PRESENT_PACING_TIMEOUT_NS);
+
+			benchmark.addSample("present_pacing_wait_ms", MgeBenchmark::millisecondsSince(presentWaitStart));
+
+			collectPresents();
+		}
+
+		benchmark.addSample("frame_pacing_error_ms", frameLimiter.waitForNextFrame());
+	}
+
+	bool MgeEngine::waitForRedraw()
+	{
+		if (!redrawRequested && !isAnimating())
+		{
+			// Nothing to do until an event arrives, the thread sleeps here while the window is idle
+			glfwWaitEvents();
+
+			// The idle time is not camera motion
+			lastCameraUpdate = MgeBenchmark::Clock::now();
+
+			if (!redrawRequested && !isAnimating())
+			{
+				idleWakeups++;
+				return false;
+			}
+		}
+
+		redrawRequested = false;
+
+		return true;
+	}
+
+	bool MgeEngine::isAnimating() const
+	{
+		return isCameraMoving() || textureManager.hasPendingWork();
+	}
+
+	/*
+	* Thread scaling benchmark
+	*
+	* Runs the configured benchmark once per recording thread count, from 1 up to the number of
+	* workers created. Every run writes its own JSON report (<report>_t<threads>.json) and a summary
+	* of recording time and frame rate per thread count is printed at the end.
+	*/
+	void MgeEngine::runThreadScaling()
+	{
+		struct ScalingResult
+		{
+			unsigned int threads;
+			double fps;
+			MgeBenchmark::Statistics record;
+			MgeBenchmark::Statistics frame;
+		};
+
+		std::vector<ScalingResult> results;
+
+		std::filesystem::path reportPath(config.benchmarkReport);
+
+		for (unsigned int threads = 1; threads <= maxRecordingThreads; threads++)
+		{
+			activeRecordingThreads = threads;
+
+			benchmark.configure(config.benchmarkWarmupFrames, config.benchmarkFrames);
+
+			runFrames();
+
+			// Window closed before the run completed
+			if (!benchmark.isFinished())
+			{
+				break;
+			}
+
+			std::filesystem::path threadReport = reportPath.parent_path() /
+				(reportPath.stem().string() + "_t" + std::to_string(threads) + reportPath.extension().string());
+
+			reportBenchmark(threadReport.string());
+
+			double seconds = benchmark.getTimedSeconds();
+
+			results.push_back({ threads, seconds > 0.0 ? benchmark.getTimedFrames() / seconds : 0.0,
+				MgeBenchmark::computeStatistics(benchmark.getSamples("record_ms")),
+				MgeBenchmark::computeStatistics(benchmark.getSamples("cpu_frame_ms")) });
+		}
+
+		if (results.empty())
+		{
+			return;
+		}
+
+		std::cout << "\n==== Recording thread scaling : " << drawList.size() << " draws ====\n";
+		std::cout << "  threads      fps   record p50   record p99   speedup\n";
+
+		for (const auto& result : results)
+		{
+			double speedup = result.record.p50 > 0.0 ? results.front().record.p50 / result.record.p50 : 0.0;
+
+			std::cout << "  " << std::setw(7) << result.threads
+				<< std::fixed << std::setprecision(1) << std::setw(9) << result.fps
+				<< std::setprecision(3) << std::setw(13) << result.record.p50 << std::setw(13) << result.record.p99
+				<< std::setprecision(2) << std::setw(10) << speedup << "x\n";
+		}
+
+		std::cout << std::defaultfloat << std::endl;
+	}
+
+	void MgeEngine::runInstanceStress()
+	{
+		struct StressResult
+		{
+			unsigned int instances;
+			double fps;
+			MgeBenchmark::Statistics frame;
+		};
+
+		std::vector<StressResult> results;
+
+		std::filesystem::path reportPath(config.benchmarkReport);
+
+		for (unsigned int instances : INSTANCE_STRESS_COUNTS)
+		{
+			setInstanceCount(instances);
+
+			benchmark.configure(config.benchmarkWarmupFrames, config.benchmarkFrames);
+
+			runFrames();
+
+			// Window closed before the run completed
+			if (!benchmark.isFinished())
+			{
+				break;
+			}
+
+			std::filesystem::path instanceReport = reportPath.parent_path() /
+				(reportPath.stem().string() + "_i" + std::to_string(instances) + reportPath.extension().string());
+
+			reportBenchmark(instanceReport.string());
+
+			double seconds = benchmark.getTimedSeconds();
+
+			results.push_back({ instances, seconds > 0.0 ? benchmark.getTimedFrames() / seconds : 0.0,
+				MgeBenchmark::computeStatistics(benchmark.getSamples("cpu_frame_ms")) });
+		}
+
+		if (results.empty())
+		{
+			return;
+		}
+
+		std::cout << "\n==== Instanced stress : " << drawList.size() << " draw calls per frame ====\n";
+		std::cout << "  instances      fps   frame p50   frame p99   draws/s   Minstances/s\n";
+
+		for (const auto& result : results)
+		{
+			std::cout << "  " << std::setw(9) << result.instances
+				<< std::fixed << std::setprecision(1) << std::setw(9) << result.fps
+				<< std::setprecision(3) << std::setw(12) << result.frame.p50 << std::setw(12) << result.frame.p99
+				<< std::setprecision(0) << std::setw(10) << result.fps * drawList.size()
+				<< std::setprecision(1) << std::setw(15) << result.fps * result.instances / 1000000.0 << "\n";
+		}
+
+		std::cout << std::defaultfloat << std::endl;
 	}
 
 	void MgeEngine::run()
 	{
-		initWindow();
+		if (!config.headless)
+		{
+			if (initWindow() != EXIT_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create window!");
+			}
+		}
+
+		// Startup cost, reported with the benchmark (fewer objects to create with the dynamic rendering backend)
+		auto initStart = MgeBenchmark::Clock::now();
+
 		initVulkan();
+
+		initVulkanMilliseconds = MgeBenchmark::millisecondsSince(initStart);
+
 		mainLoop();
 		cleanUp();
 	}
 
+	bool MgeEngine::getShouldClose()
+	{
+		if (config.frameCount > 0 && framesRendered >= config.frameCount)
+		{
+			return true;
+		}
+
+		if (benchmark.isFinished())
+		{
+			return true;
+		}
+
+		// Without a window there is nothing to close, only the frame count ends a headless run
+		return !config.headless && glfwWindowShouldClose(mainWindow);
+	}
+
 	// Vulkan Initialization
 
 	void MgeEngine::initVulkan()
@@ -116,29 +418,148 @@ namespace mge {
 
 		setupDebugMessenger();
 
-		createSurface();
+		if (!config.headless)
+		{
+			createSurface();
+		}
 
 		pickPhysicalDevice();
 
 		createLogicalDevice();
 
-		createSwapChain();
+		allocator.init(physicalDevice, device);
+
+		renderGraph.init(device, allocator);
+
+		descriptorLayoutCache.init(device);
+
+		bindlessTable.init(physicalDevice, device, descriptorLayoutCache);
+
+		textureManager.init(physicalDevice, device, allocator, bindlessTable, graphicsQueue,
+			findQueueFamilies(physicalDevice).graphicsFamily.value(), config.textureBudget);
+
+		// A finished load wakes the on-demand loop out of glfwWaitEvents, the next update() picks it up
+		if (config.renderOnDemand)
+		{
+			textureManager.setLoadedCallback([]() { glfwPostEmptyEvent(); });
+		}
+
+		// The stress run starts at its smallest instance count, the pipeline is built for the instanced path
+		if (config.instanceStress)
+		{
+			config.instanceCount = INSTANCE_STRESS_COUNTS.front();
+		}
+
+		framesInFlight = getProfileFramesInFlight(config.presentProfile);
+
+		if (config.headless)
+		{
+			createOffscreenImages();
+		}
+		else
+		{
+			createSwapChain();
+		}
 
 		createImageViews();
 
-		createRenderPass();
+		// Everything working in frame slots is sized once the image count is known
+		frameSlotCount = getRequiredFrameSlots();
+
+		descriptorAllocator.init(device, frameSlotCount);
+
+		// The upscale pass blits the scene target into the swapchain image with linear filtering
+		if (usesRenderScale())
+		{
+			// Framebuffers only exist for the swapchain images, not for the render graph's transients
+			if (config.renderBackend != MgeRenderBackend::Dynamic)
+			{
+				throw std::runtime_error("Render scale needs the dynamic rendering backend!");
+			}
+
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &formatProperties);
+
+			VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+				VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+			if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+			{
+				throw std::runtime_error("Failed to find blit support for the swapchain format!");
+			}
+		}
+
+		// Dynamic rendering draws straight into the image views, no render pass or framebuffers
+		if (config.renderBackend == MgeRenderBackend::RenderPass)
+		{
+			createRenderPass();
+		}
+
+		createPipelineCache();
+
+		createCameraResources();
 
 		createGraphicsPipeline();
 
-		createFrameBuffers();
+		if (config.gpuCulling)
+		{
+			createCullPipeline();
+		}
+
+		if (config.renderBackend == MgeRenderBackend::RenderPass)
+		{
+			createFrameBuffers();
+		}
 
 		// GPU
 		createCommandPool();
 
+		// The scaling benchmark goes up to the hardware thread count unless told otherwise
+		maxRecordingThreads = config.recordingThreads;
+
+		if (config.threadScaling && maxRecordingThreads == 0)
+		{
+			maxRecordingThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		activeRecordingThreads = config.threadScaling ? 1 : maxRecordingThreads;
+
+		createFrameResources();
+
+		recordingPool.start(maxRecordingThreads);
+
+		gpuProfiler.init(physicalDevice, device, findQueueFamilies(physicalDevice).graphicsFamily.value(), pipelineStatisticsEnabled, frameSlotCount);
+
+		// Uploads fall back to the graphics queue when there is no dedicated transfer family
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+		if (queueFamilyIndices.transferFamily.has_value())
+		{
+			uploader.init(device, allocator, transferQueue, queueFamilyIndices.transferFamily.value(),
+				graphicsQueue, queueFamilyIndices.graphicsFamily.value());
+		}
+		else
+		{
+			uploader.init(device, allocator, graphicsQueue, queueFamilyIndices.graphicsFamily.value(),
+				graphicsQueue, queueFamilyIndices.graphicsFamily.value());
+		}
+
 		createVertexBuffer();
 
 		createIndexBuffer();
 
+		createInstanceBuffer();
+
+		createMaterialBuffer();
+
+		loadTextures();
+
+		// One submission for all start-up uploads. The first frame draws with them, so make sure they
+		// are handed over to the graphics queue (a no-op when uploading on the graphics queue itself).
+		uploader.makeAvailable(uploader.flush());
+
+		buildDrawList();
+
 		createCommandBuffers();
 
 		createSyncObjects();
@@ -247,13 +668,19 @@ namespace mge {
 
 	std::vector<const char*> MgeEngine::getRequiredExtensions()
 	{
+		std::vector<const char*> extensions;
+
+		// GLFW is never initialised in headless mode and no surface extensions are needed
 
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
+		if (!config.headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
 
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers)
 		{
@@ -350,8 +777,12 @@ namespace mge {
 		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
 		// And we'll check if any of the physical devices meet the requirements that we'll add to that function.
+		bool anyVulkan13 = false;
+
 		for (const auto& device : devices)
 		{
+			anyVulkan13 = anyVulkan13 || supportsVulkan13(device);
+
 			if (isDeviceSuitable(device))
 			{
 				physicalDevice = device;
@@ -359,6 +790,11 @@ namespace mge {
 			}
 		}
 
+		if (!anyVulkan13)
+		{
+			throw std::runtime_error("Failed to find a GPU with Vulkan 1.3 support!");
+		}
+
 		if (physicalDevice == VK_NULL_HANDLE)
 		{
 			throw std::runtime_error("Failed to find a suitable GPU");
@@ -392,12 +828,33 @@ namespace mge {
 
 	}
 
+	bool MgeEngine::supportsVulkan13(VkPhysicalDevice device)
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+		return deviceProperties.apiVersion >= VK_API_VERSION_1_3;
+	}
+
 	bool MgeEngine::isDeviceSuitable(VkPhysicalDevice device)
 	{
+		// The Vulkan 1.3 feature chain, synchronization2 barriers and dynamic rendering are core 1.3
+		if (!supportsVulkan13(device))
+		{
+			return false;
+		}
+
 		QueueFamilyIndices indices = findQueueFamilies(device);
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
+		// Headless rendering only needs a graphics queue, there is nothing to present to
+
+		if (config.headless)
+		{
+			return indices.graphicsFamily.has_value() && extensionsSupported;
+		}
+
 		bool swapChainAdequate = false;
 
 		if (extensionsSupported) {
@@ -430,7 +887,9 @@ namespace mge {
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+		std::vector<const char*> required = getRequiredDeviceExtensions();
+
+		std::set<std::string> requiredExtensions(required.begin(), required.end());
 
 		for (const auto& extension : availableExtensions) {
 			requiredExtensions.erase(extension.extensionName);
@@ -439,20 +898,54 @@ namespace mge {
 		return requiredExtensions.empty();
 	}
 
-	void MgeEngine::createLogicalDevice()
+	bool MgeEngine::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
 	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
-		/*
-		* The creation of a logical device involves specifying a bunch of details in structs again,
-		of which the first one will be VkDeviceQueueCreateInfo. This structure describes the number
-		of queues we want for a single queue family. Right now we're only interested in a queue with
-		graphics capabilities.
-		*/
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+		return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+			[&](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, extensionName) == 0; });
+	}
+
+	std::vector<const char*> MgeEngine::getRequiredDeviceExtensions() const
+	{
+		// VK_KHR_swapchain is only needed when we present to a window
+
+		if (config.headless)
+		{
+			return {};
+		}
+
+		return deviceExtensions;
+	}
+
+	void MgeEngine::createLogicalDevice()
+	{
+
+		/*
+		* The creation of a logical device involves specifying a bunch of details in structs again,
+		of which the first one will be VkDeviceQueueCreateInfo. This structure describes the number
+		of queues we want for a single queue family. Right now we're only interested in a queue with
+		graphics capabilities.
+		*/
+
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<unsigned int> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		std::set<unsigned int> uniqueQueueFamilies = { indices.graphicsFamily.value() };
+
+		if (indices.presentFamily.has_value())
+		{
+			uniqueQueueFamilies.insert(indices.presentFamily.value());
+		}
+
+		if (indices.transferFamily.has_value())
+		{
+			uniqueQueueFamilies.insert(indices.transferFamily.value());
+		}
 
 		/*
 		* Vulkan lets you assign priorities to queues to influence the scheduling of command buffer
@@ -481,6 +974,118 @@ namespace mge {
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
 
+		// Query core, Vulkan 1.2 and 1.3 features in one go through the features2 chain
+
+		// Present id / present wait are optional, they only tell when a frame reached the screen for the latency measurement
+		bool presentWaitExtensions = !config.headless && isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+			isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+		VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWaitFeatures{};
+		supportedPresentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+		VkPhysicalDevicePresentIdFeaturesKHR supportedPresentIdFeatures{};
+		supportedPresentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		supportedPresentIdFeatures.pNext = &supportedPresentWaitFeatures;
+
+		VkPhysicalDeviceVulkan13Features supportedVulkan13Features{};
+		supportedVulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		supportedVulkan13Features.pNext = presentWaitExtensions ? &supportedPresentIdFeatures : nullptr;
+
+		VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+		supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		supportedVulkan12Features.pNext = &supportedVulkan13Features;
+
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supportedVulkan12Features;
+
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+		// Pipeline statistics are optional, the GPU profiler only reports invocation counts when available
+
+		deviceFeatures.pipelineStatisticsQuery = supportedFeatures.features.pipelineStatisticsQuery;
+		pipelineStatisticsEnabled = supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+
+		// Without inheritedQueries the main pass only gets statistics when it is recorded inline
+		deviceFeatures.inheritedQueries = supportedFeatures.features.inheritedQueries;
+		inheritedQueriesEnabled = supportedFeatures.features.inheritedQueries == VK_TRUE;
+
+		// Frame pacing and deferred deletion run on a timeline semaphore (core and mandatory since 1.2)
+
+		if (!supportedVulkan12Features.timelineSemaphore)
+		{
+			throw std::runtime_error("Failed to find timeline semaphore support!");
+		}
+
+		// The bindless table: unsized, partially written arrays that are updated while in use,
+		// textures indexed by values that may differ per invocation (instance data)
+
+		if (!supportedVulkan12Features.runtimeDescriptorArray || !supportedVulkan12Features.descriptorBindingPartiallyBound ||
+			!supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind ||
+			!supportedVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind ||
+			!supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending ||
+			!supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing ||
+			!supportedFeatures.features.shaderSampledImageArrayDynamicIndexing ||
+			!supportedFeatures.features.shaderStorageBufferArrayDynamicIndexing)
+		{
+			throw std::runtime_error("Failed to find descriptor indexing support!");
+		}
+
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+
+		// The render graph records its barriers with vkCmdPipelineBarrier2 (core and mandatory since 1.3)
+
+		if (!supportedVulkan13Features.synchronization2)
+		{
+			throw std::runtime_error("Failed to find synchronization2 support!");
+		}
+
+		// The dynamic rendering backend begins passes without render pass objects
+
+		bool dynamicRendering = config.renderBackend == MgeRenderBackend::Dynamic;
+
+		if (dynamicRendering && !supportedVulkan13Features.dynamicRendering)
+		{
+			throw std::runtime_error("Failed to find dynamic rendering support!");
+		}
+
+		VkPhysicalDeviceVulkan13Features vulkan13Features{};
+		vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		vulkan13Features.dynamicRendering = dynamicRendering ? VK_TRUE : VK_FALSE;
+		vulkan13Features.synchronization2 = VK_TRUE;
+
+		presentWaitEnabled = presentWaitExtensions && supportedPresentIdFeatures.presentId && supportedPresentWaitFeatures.presentWait;
+
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		presentWaitFeatures.presentWait = VK_TRUE;
+
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.presentId = VK_TRUE;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+
+		if (presentWaitEnabled)
+		{
+			vulkan13Features.pNext = &presentIdFeatures;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.timelineSemaphore = VK_TRUE;
+		vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+		vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		vulkan12Features.pNext = &vulkan13Features;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &vulkan12Features;
+
 		/*
 		* Creating the logical device
 		* With the previous two structures in place, we can start filling in the main VkDeviceCreateInfo structure.
@@ -494,7 +1099,10 @@ namespace mge {
 
 		createInfo.queueCreateInfoCount = static_cast<unsigned int>(queueCreateInfos.size());
 
-		createInfo.pEnabledFeatures = &deviceFeatures;
+		// Features go through the pNext chain, pEnabledFeatures has to stay null then
+		deviceFeatures2.features = deviceFeatures;
+		createInfo.pNext = &deviceFeatures2;
+		createInfo.pEnabledFeatures = nullptr;
 
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
@@ -504,8 +1112,16 @@ namespace mge {
 		* images from that device to windows.
 		*/
 
-		createInfo.enabledExtensionCount = static_cast<unsigned int> (deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions = getRequiredDeviceExtensions();
+
+		if (presentWaitEnabled)
+		{
+			enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		}
+
+		createInfo.enabledExtensionCount = static_cast<unsigned int> (enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -524,6 +1140,13 @@ namespace mge {
 			throw std::runtime_error("Failed to create logical device!");
 		}
 
+		// Extension command, not exported by the loader
+		if (presentWaitEnabled)
+		{
+			waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+			presentWaitEnabled = waitForPresent != nullptr;
+		}
+
 		/*
 		* We can use the vkGetDeviceQueue function to retrieve queue handles for each queue family.
 		* The parameters are the logical device, queue family, queue index and a pointer to the variable to store
@@ -531,7 +1154,16 @@ namespace mge {
 		*/
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+		if (indices.presentFamily.has_value())
+		{
+			vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+		}
+
+		if (indices.transferFamily.has_value())
+		{
+			vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+		}
 
 	}
 
@@ -579,16 +1211,21 @@ namespace mge {
 				indices.graphicsFamily = i;
 			}
 
-			VkBool32 presentSupport = false;
+			// Without a surface (headless) there is no present support to query
 
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-			if (presentSupport)
+			if (surface != VK_NULL_HANDLE)
 			{
-				indices.presentFamily = i;
+				VkBool32 presentSupport = false;
+
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+				if (presentSupport)
+				{
+					indices.presentFamily = i;
+				}
 			}
 
-			if (indices.isCompleted())
+			if (indices.isCompleted() || (surface == VK_NULL_HANDLE && indices.graphicsFamily.has_value()))
 			{
 				break;
 			}
@@ -596,23 +1233,51 @@ namespace mge {
 			i++;
 		}
 
+		/*
+		* Dedicated transfer queue
+		*
+		* A family with transfer but without graphics maps to the copy engines on most discrete GPUs,
+		* so uploads there run next to rendering. An async compute family (compute but no graphics) is
+		* the next best thing. Compute and graphics families implicitly support transfer.
+		*/
+
+		if (config.useTransferQueue)
+		{
+			for (unsigned int family = 0; family < queueFamilyCount; family++)
+			{
+				VkQueueFlags flags = queueFamilies[family].queueFlags;
+
+				if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				{
+					indices.transferFamily = family;
+					break;
+				}
+			}
+
+			for (unsigned int family = 0; family < queueFamilyCount && !indices.transferFamily.has_value(); family++)
+			{
+				VkQueueFlags flags = queueFamilies[family].queueFlags;
+
+				if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+				{
+					indices.transferFamily = family;
+				}
+			}
+		}
+
 		return indices;
 	}
 
 	// Create Swapchain
 
-	void MgeEngine::createSwapChain() {
+	void MgeEngine::createSwapChain(VkSwapchainKHR oldSwapChain) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-
-		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-			imageCount = swapChainSupport.capabilities.maxImageCount;
-		}
+		uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities);
 
 		VkSwapchainCreateInfoKHR createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -625,6 +1290,17 @@ namespace mge {
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+		// The upscale pass blits into the swapchain image
+		if (usesRenderScale())
+		{
+			if ((swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0)
+			{
+				throw std::runtime_error("Failed to find swapchain support for transfer destination images!");
+			}
+
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		}
+
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 		uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -642,7 +1318,12 @@ namespace mge {
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
 
-		// createInfo.oldSwapchain = VK_NULL_HANDLE;
+		/*
+		* Handing the old swapchain over lets the presentation engine reuse its resources and keep
+		* showing its images until the new ones are ready. The old swapchain is retired either way
+		* (even if creation fails), it is destroyed later through the deletion queue.
+		*/
+		createInfo.oldSwapchain = oldSwapChain;
 
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
@@ -654,6 +1335,7 @@ namespace mge {
 
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
+		swapChainPresentMode = presentMode;
 	}
 
 	MgeEngine::SwapChainSupportDetails MgeEngine::querySwapChainSupport(VkPhysicalDevice device) {
@@ -691,15 +1373,52 @@ namespace mge {
 	}
 
 	VkPresentModeKHR MgeEngine::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				return availablePresentMode;
+		std::vector<VkPresentModeKHR> preferredModes;
+
+		switch (config.presentProfile)
+		{
+		case MgePresentProfile::LowLatency:
+			// FIFO_RELAXED shows a late frame straight away instead of holding it for another vblank
+			preferredModes = { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+			break;
+		case MgePresentProfile::Throughput:
+			preferredModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+			break;
+		default:
+			preferredModes = { config.preferredPresentMode };
+			break;
+		}
+
+		for (auto preferredMode : preferredModes) {
+			for (const auto& availablePresentMode : availablePresentModes) {
+				if (availablePresentMode == preferredMode) {
+					return availablePresentMode;
+				}
 			}
 		}
 
+		// FIFO is the only mode every implementation has to support
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
+	unsigned int MgeEngine::chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities) {
+		unsigned int imageCount = capabilities.minImageCount;
+
+		// Every extra image is another frame that can queue up between rendering and the display
+		switch (config.presentProfile)
+		{
+		case MgePresentProfile::LowLatency: break;
+		case MgePresentProfile::Throughput: imageCount += 2; break;
+		default: imageCount += 1; break;
+		}
+
+		if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+			imageCount = capabilities.maxImageCount;
+		}
+
+		return imageCount;
+	}
+
 	VkExtent2D MgeEngine::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
 			return capabilities.currentExtent;
@@ -720,6 +1439,66 @@ namespace mge {
 		}
 	}
 
+	/*
+	* Headless offscreen images
+	*
+	* Without a swapchain the engine allocates its own colour images and hands them to the rest of
+	* the renderer through swapChainImages / swapChainImageFormat / swapChainExtent, so image views,
+	* the render pass, the pipeline, the frame buffers and the recorded command buffers are all
+	* shared with the windowed path. The images are rotated through like swapchain images would be.
+	*/
+
+	VkFormat MgeEngine::chooseOffscreenFormat()
+	{
+		const VkFormat candidates[] = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM };
+
+		for (VkFormat format : candidates)
+		{
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+			if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+			{
+				return format;
+			}
+		}
+
+		throw std::runtime_error("Failed to find a colour attachment format for offscreen rendering!");
+	}
+
+	void MgeEngine::createOffscreenImages()
+	{
+		swapChainImageFormat = chooseOffscreenFormat();
+		swapChainExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+
+		swapChainImages.resize(std::max(config.headlessImageCount, 1u));
+		offscreenImageAllocations.resize(swapChainImages.size());
+
+		for (unsigned long long i = 0; i < swapChainImages.size(); i++)
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = swapChainImageFormat;
+			imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				(usesRenderScale() ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(device, &imageInfo, nullptr, &swapChainImages[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create offscreen image!");
+			}
+
+			allocator.bindImage(swapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreenImageAllocations[i]);
+		}
+	}
+
 	// Create ImageView
 
 	void MgeEngine::createImageViews()
@@ -788,8 +1567,10 @@ namespace mge {
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		// The render graph transitions the image around the pass, the render pass leaves the layout alone
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef{};
 
@@ -802,14 +1583,6 @@ namespace mge {
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &colorAttachmentRef;
 
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
 		VkRenderPassCreateInfo renderPassInfo{};
 
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -817,9 +1590,8 @@ namespace mge {
 		renderPassInfo.pAttachments = &colorAttachment;
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency; 
+
+		// No subpass dependency either, the barrier before the pass comes from the render graph
 
 		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
 		{
@@ -830,7 +1602,12 @@ namespace mge {
 
 	void MgeEngine::createGraphicsPipeline()
 	{
-		auto vertShaderCode = ReadFile(vertShaderFile);
+		bool instanced = config.instanceCount > 0;
+
+		// Culled instances are looked up through the cull pass's visible list instead of a vertex binding
+		bool culled = instanced && config.gpuCulling;
+
+		auto vertShaderCode = ReadFile(culled ? culledVertShaderFile : instanced ? instancedVertShaderFile : vertShaderFile);
 		auto fragShaderCode = ReadFile(fragShaderFile);
 
 		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -860,13 +1637,37 @@ namespace mge {
 		vertexInputInfo.vertexAttributeDescriptionCount = 0;
 		vertexInputInfo.vertexAttributeDescriptionCount = 0;
 
-		// Setup graphics pipeline to accept the graphics format
-		auto bindingDesription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		// Setup graphics pipeline to accept the graphics format, the layouts are generated from the vertex structs
+		std::vector<VkVertexInputBindingDescription> bindingDesriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+		if (config.packedVertices)
+		{
+			auto vertexAttributes = PackedVertexLayout::getAttributeDescriptions(0, 0);
+
+			bindingDesriptions.push_back(PackedVertexLayout::getBindingDescription(0));
+			attributeDescriptions.insert(attributeDescriptions.end(), vertexAttributes.begin(), vertexAttributes.end());
+		}
+		else
+		{
+			auto vertexAttributes = VertexLayout::getAttributeDescriptions(0, 0);
+
+			bindingDesriptions.push_back(VertexLayout::getBindingDescription(0));
+			attributeDescriptions.insert(attributeDescriptions.end(), vertexAttributes.begin(), vertexAttributes.end());
+		}
+
+		// The instanced path adds the per-instance binding
+		if (instanced && !culled)
+		{
+			auto instanceAttributes = InstanceLayout::getAttributeDescriptions(1, 2);
+
+			bindingDesriptions.push_back(InstanceLayout::getBindingDescription(1));
+			attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+		}
 
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<unsigned int>(bindingDesriptions.size());
 		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<unsigned int>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDesription;
+		vertexInputInfo.pVertexBindingDescriptions = bindingDesriptions.data();
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 		// 2. Input Assembly
@@ -879,29 +1680,26 @@ namespace mge {
 
 		// 3. Viewport and Scissor
 
-		VkViewport viewport{};
-
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapChainExtent.width);
-		viewport.height = static_cast<float>(swapChainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{};
+		/*
+		* Dynamic State
+		*
+		* Viewport and scissor are set with vkCmdSetViewport / vkCmdSetScissor when the command buffer
+		* is recorded, so the pipeline does not depend on the swapchain extent and survives a resize.
+		* Only the counts are given here.
+		*/
 
-		scissor.offset = { 0,0 };
-		scissor.extent = swapChainExtent;
+		std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
-		// Dynamic State
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<unsigned int>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
 
 		VkPipelineViewportStateCreateInfo viewportState{};
 
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
 
 		// Rasterization
 
@@ -939,10 +1737,20 @@ namespace mge {
 		colorBlending.blendConstants[2] = 0.0f;
 		colorBlending.blendConstants[3] = 0.0f;
 
+		// Set 0 = camera (dynamic uniform buffer), set 1 = bindless table, push constants = per-draw data
+		VkDescriptorSetLayout setLayouts[] = { cameraDescriptorSetLayout, bindlessTable.getLayout() };
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawConstants);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -964,12 +1772,25 @@ namespace mge {
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState = &multiSampling;
 		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = pipelineLayout;
 		pipelineInfo.renderPass = renderPass;
 		pipelineInfo.subpass = 0;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+		// Without a render pass the pipeline states the attachment formats it renders to itself
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+
+		if (config.renderBackend == MgeRenderBackend::Dynamic)
+		{
+			pipelineInfo.renderPass = VK_NULL_HANDLE;
+			pipelineInfo.pNext = &renderingInfo;
+		}
+
+		if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create graphics pipeline!");
 		}
@@ -978,334 +1799,1847 @@ namespace mge {
 		vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	}
 
-	void MgeEngine::createFrameBuffers()
-	{
-		swapChainFrameBuffers.resize(swapChainImageViews.size());
-
-		for (unsigned long long i = 0; i < swapChainImageViews.size(); i++)
-		{
-			VkImageView attachments[] =
-			{
-				swapChainImageViews[i]
-			};
+	// Camera
 
-			VkFramebufferCreateInfo frameBufferInfo{};
+	void MgeEngine::createCameraResources()
+	{
+		uniformRing.init(physicalDevice, allocator, frameSlotCount, UNIFORM_RING_SLOT_SIZE);
 
-			frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			frameBufferInfo.renderPass = renderPass;
-			frameBufferInfo.attachmentCount = 1;
-			frameBufferInfo.pAttachments = attachments;
-			frameBufferInfo.width = swapChainExtent.width;
-			frameBufferInfo.height = swapChainExtent.height;
-			frameBufferInfo.layers = 1;
+		VkDescriptorSetLayoutBinding cameraBinding{};
+		cameraBinding.binding = 0;
+		cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		cameraBinding.descriptorCount = 1;
+		cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-			if (vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &swapChainFrameBuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to create frame buffer!");
-			}
-		}
+		cameraDescriptorSetLayout = descriptorLayoutCache.getLayout({ cameraBinding });
 	}
 
-	// GPU
-	void MgeEngine::createCommandPool()
+	void MgeEngine::destroyCameraResources()
 	{
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
-
-		VkCommandPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-
-		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create command pool!");
-		}
+		uniformRing.destroy();
 	}
 
-	void MgeEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	void MgeEngine::updateCamera()
 	{
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = size;
-		bufferInfo.usage = usage;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		auto now = MgeBenchmark::Clock::now();
+		float seconds = static_cast<float>(MgeBenchmark::millisecondsSince(lastCameraUpdate) / 1000.0);
+		lastCameraUpdate = now;
 
-		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create buffer");
-		}
+		// Pans half a screen per second whatever the zoom, zooms by 2x per second
+		float panSpeed = 1.0f / cameraZoom;
 
-		// Allocate memory
-		VkMemoryRequirements memRequirements; // get memory requirements
-		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+		if (glfwGetKey(mainWindow, GLFW_KEY_LEFT) == GLFW_PRESS) cameraPosition.x -= panSpeed * seconds;
+		if (glfwGetKey(mainWindow, GLFW_KEY_RIGHT) == GLFW_PRESS) cameraPosition.x += panSpeed * seconds;
+		if (glfwGetKey(mainWindow, GLFW_KEY_UP) == GLFW_PRESS) cameraPosition.y -= panSpeed * seconds;
+		if (glfwGetKey(mainWindow, GLFW_KEY_DOWN) == GLFW_PRESS) cameraPosition.y += panSpeed * seconds;
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		if (glfwGetKey(mainWindow, GLFW_KEY_PAGE_UP) == GLFW_PRESS) cameraZoom *= std::pow(2.0f, seconds);
+		if (glfwGetKey(mainWindow, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS) cameraZoom /= std::pow(2.0f, seconds);
 
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to allocate buffer memory");
-		}
+		cameraZoom = std::clamp(cameraZoom, 0.01f, 100.0f);
+	}
 
-		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+	bool MgeEngine::isCameraMoving() const
+	{
+		const int cameraKeys[] = { GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_PAGE_UP, GLFW_KEY_PAGE_DOWN };
 
+		return std::any_of(std::begin(cameraKeys), std::end(cameraKeys),
+			[this](int key) { return glfwGetKey(mainWindow, key) == GLFW_PRESS; });
 	}
 
-	void MgeEngine::createVertexBuffer()
+	void MgeEngine::writeCameraData(unsigned int slot)
 	{
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
+		// World space is the original clip space, zoom 1 at the origin shows -1 .. 1 on both axes
+		float halfExtent = 1.0f / cameraZoom;
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		CameraData camera{};
+		camera.visibleRegion = glm::vec4(cameraPosition.x - halfExtent, cameraPosition.y - halfExtent,
+			cameraPosition.x + halfExtent, cameraPosition.y + halfExtent);
+		camera.viewProjection = glm::ortho(camera.visibleRegion.x, camera.visibleRegion.z, camera.visibleRegion.y, camera.visibleRegion.w);
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (unsigned long long)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-		copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		uniformRing.beginFrame(slot);
 
+		uniformRing.push(camera);
 	}
 
-	void MgeEngine::createIndexBuffer()
-	{
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	/*
+	* Pipeline cache file
+	*
+	* The driver blob is wrapped in a small header of our own so a truncated or corrupted file is
+	* detected before it is handed to the driver:
+	*
+	*     PipelineCacheFileHeader | VkPipelineCacheHeaderVersionOne | driver data ...
+	*
+	* The blob is only used when its Vulkan header matches this device (vendor ID, device ID and
+	* pipeline cache UUID) and the driver version it was written with. Anything else starts from an
+	* empty cache, which only costs compile time.
+	*/
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (unsigned long long)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-		copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	namespace {
+		const unsigned int PIPELINE_CACHE_MAGIC = 0x4350474D; // "MGPC"
+		const unsigned int PIPELINE_CACHE_FILE_VERSION = 1;
 
+		struct PipelineCacheFileHeader
+		{
+			unsigned int magic;
+			unsigned int version;
+			unsigned int driverVersion;
+			unsigned int reserved;
+			unsigned long long dataSize;
+			unsigned long long checksum;
+		};
 	}
 
-	unsigned int MgeEngine::findMemoryType(unsigned int typeFilter, VkMemoryPropertyFlags properties)
+	unsigned long long MgeEngine::hashPipelineCacheData(const char* data, size_t size)
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		// FNV-1a, good enough to catch truncation and bit rot
+		unsigned long long hash = 14695981039346656037ULL;
 
-		for (unsigned int i = 0; i < memProperties.memoryTypeCount; i++)
+		for (size_t i = 0; i < size; i++)
 		{
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-			{
-				return i;
-			}
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
 		}
 
-		throw std::runtime_error("Failed to find suitable memory type!");
+		return hash;
 	}
 
-	void MgeEngine::createCommandBuffers()
+	std::vector<char> MgeEngine::loadPipelineCacheData()
 	{
-		commandBuffers.resize(swapChainFrameBuffers.size());
-
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = commandPool;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = static_cast<unsigned int>(commandBuffers.size());
+		std::ifstream file(config.pipelineCacheFile, std::ios::ate | std::ios::binary);
 
-		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		if (!file.is_open())
 		{
-			throw std::runtime_error("Failed to allocate command buffers");
+			return {};
 		}
 
-		for (unsigned long long i = 0; i < commandBuffers.size(); i++)
+		unsigned long long fileSize = (unsigned long long) file.tellg();
+
+		if (fileSize < sizeof(PipelineCacheFileHeader) + sizeof(VkPipelineCacheHeaderVersionOne))
 		{
-			VkCommandBufferBeginInfo beginInfo{ };
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			std::cerr << "Pipeline cache : " << config.pipelineCacheFile << " is too small, ignoring it" << std::endl;
+			return {};
+		}
 
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed t o begin recording command buffer!");
+		PipelineCacheFileHeader header{};
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_FILE_VERSION ||
+			header.dataSize != fileSize - sizeof(PipelineCacheFileHeader))
+		{
+			std::cerr << "Pipeline cache : " << config.pipelineCacheFile << " is corrupt, ignoring it" << std::endl;
+			return {};
+		}
+
+		if (header.driverVersion != deviceProperties.driverVersion)
+		{
+			std::cout << "Pipeline cache : driver version changed, starting with an empty cache" << std::endl;
+			return {};
+		}
+
+		std::vector<char> data(header.dataSize);
+		file.read(data.data(), data.size());
+
+		if (!file || hashPipelineCacheData(data.data(), data.size()) != header.checksum)
+		{
+			std::cerr << "Pipeline cache : " << config.pipelineCacheFile << " failed its checksum, ignoring it" << std::endl;
+			return {};
+		}
+
+		VkPipelineCacheHeaderVersionOne cacheHeader{};
+		memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+
+		if (cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			cacheHeader.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) ||
+			cacheHeader.vendorID != deviceProperties.vendorID ||
+			cacheHeader.deviceID != deviceProperties.deviceID ||
+			memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			std::cout << "Pipeline cache : written by a different device or driver, starting with an empty cache" << std::endl;
+			return {};
+		}
+
+		return data;
+	}
+
+	void MgeEngine::createPipelineCache()
+	{
+		std::vector<char> initialData;
+
+		if (!config.pipelineCacheFile.empty())
+		{
+			initialData = loadPipelineCacheData();
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = initialData.size();
+		cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) == VK_SUCCESS)
+		{
+			if (!initialData.empty())
+			{
+				std::cout << "Pipeline cache : loaded " << initialData.size() << " bytes from " << config.pipelineCacheFile << std::endl;
+			}
+
+			return;
+		}
+
+		// The driver rejected the data even though the header matched, fall back to an empty cache
+
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	void MgeEngine::savePipelineCache()
+	{
+		if (pipelineCache == VK_NULL_HANDLE || config.pipelineCacheFile.empty())
+		{
+			return;
+		}
+
+		size_t dataSize = 0;
+
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		{
+			return;
+		}
+
+		std::vector<char> data(dataSize);
+
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+		{
+			return;
+		}
+
+		data.resize(dataSize);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		PipelineCacheFileHeader header{};
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.version = PIPELINE_CACHE_FILE_VERSION;
+		header.driverVersion = deviceProperties.driverVersion;
+		header.dataSize = data.size();
+		header.checksum = hashPipelineCacheData(data.data(), data.size());
+
+		// Write to a temporary file and rename it over the old one, so a crash mid-write never leaves a half written cache
+
+		std::string tempFile = config.pipelineCacheFile + ".tmp";
+
+		{
+			std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open())
+			{
+				std::cerr << "Pipeline cache : failed to write " << tempFile << std::endl;
+				return;
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(data.data(), data.size());
+
+			if (!file)
+			{
+				std::cerr << "Pipeline cache : failed to write " << tempFile << std::endl;
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempFile, config.pipelineCacheFile, error);
+
+		if (error)
+		{
+			std::cerr << "Pipeline cache : failed to replace " << config.pipelineCacheFile << " : " << error.message() << std::endl;
+			std::filesystem::remove(tempFile, error);
+		}
+	}
+
+	void MgeEngine::createFrameBuffers()
+	{
+		swapChainFrameBuffers.resize(swapChainImageViews.size());
+
+		for (unsigned long long i = 0; i < swapChainImageViews.size(); i++)
+		{
+			VkImageView attachments[] =
+			{
+				swapChainImageViews[i]
+			};
+
+			VkFramebufferCreateInfo frameBufferInfo{};
+
+			frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			frameBufferInfo.renderPass = renderPass;
+			frameBufferInfo.attachmentCount = 1;
+			frameBufferInfo.pAttachments = attachments;
+			frameBufferInfo.width = swapChainExtent.width;
+			frameBufferInfo.height = swapChainExtent.height;
+			frameBufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &swapChainFrameBuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create frame buffer!");
+			}
+		}
+	}
+
+	// GPU
+	void MgeEngine::createCommandPool()
+	{
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create command pool!");
+		}
+	}
+
+	void MgeEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MgeAllocation& bufferAllocation)
+	{
+		allocator.createBuffer(size, usage, properties, buffer, bufferAllocation);
+	}
+
+	void MgeEngine::createVertexBuffer()
+	{
+		// The packed vertices are converted from the full precision ones once, at upload
+		std::vector<PackedVertex> packedVertices;
+
+		const void* vertexData = vertices.data();
+		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+
+		if (config.packedVertices)
+		{
+			packedVertices.reserve(vertices.size());
+
+			for (const auto& vertex : vertices)
+			{
+				packedVertices.push_back({ MgeHalf2::pack(vertex.pos), MgeUnorm8x4::pack(glm::vec4(vertex.color, 1.0f)) });
+			}
+
+			vertexData = packedVertices.data();
+			bufferSize = sizeof(packedVertices[0]) * packedVertices.size();
+		}
+
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
+
+		// Staged through the upload ring, submitted with the next uploader.flush()
+		uploader.uploadBuffer(vertexBuffer, 0, vertexData, bufferSize);
+
+	}
+
+	void MgeEngine::createIndexBuffer()
+	{
+		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation);
+
+		uploader.uploadBuffer(indexBuffer, 0, indices.data(), bufferSize);
+
+	}
+
+	void MgeEngine::createMaterialBuffer()
+	{
+		VkDeviceSize bufferSize = sizeof(MaterialData) * materials.size();
+
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, materialBuffer, materialBufferAllocation);
+
+		uploader.uploadBuffer(materialBuffer, 0, materials.data(), bufferSize);
+
+		materialBufferHandle = bindlessTable.registerBuffer(materialBuffer);
+	}
+
+	void MgeEngine::loadTextures()
+	{
+		for (unsigned int i = 0; i < config.textureCount; i++)
+		{
+			textures.push_back(textureManager.load([i]() { return createCheckerTexture(i); }));
+		}
+	}
+
+	void MgeEngine::updateTextures()
+	{
+		textureManager.update(deletionQueue, submissionSerial);
+
+		if (textures.empty() || config.commandRecording != MgeCommandRecording::PerFrame || instanceBuffer != VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// The region writeCameraData puts on screen, in world units per pixel
+		float halfExtent = 1.0f / cameraZoom;
+		glm::vec2 regionMin = cameraPosition - halfExtent;
+		glm::vec2 regionMax = cameraPosition + halfExtent;
+		VkExtent2D renderExtent = getRenderExtent();
+		glm::vec2 pixelsPerUnit = glm::vec2(renderExtent.width, renderExtent.height) / (2.0f * halfExtent);
+
+		for (size_t i = 0; i < drawList.size(); i++)
+		{
+			DrawItem& draw = drawList[i];
+			MgeTextureId texture = textures[i % textures.size()];
+
+			draw.constants.texture = textureManager.getBindlessHandle(texture);
+
+			// Only quads on screen ask for detail, a quad spans transform.zw around transform.xy
+			glm::vec4 transform = draw.constants.transform;
+
+			if (transform.x + transform.z * 0.5f < regionMin.x || transform.x - transform.z * 0.5f > regionMax.x ||
+				transform.y + transform.w * 0.5f < regionMin.y || transform.y - transform.w * 0.5f > regionMax.y)
+			{
+				continue;
+			}
+
+			textureManager.request(texture, std::max(transform.z * pixelsPerUnit.x, transform.w * pixelsPerUnit.y));
+		}
+	}
+
+	MgeTextureData MgeEngine::createCheckerTexture(unsigned int index)
+	{
+		MgeTextureData data;
+		data.width = TEXTURE_SIZE;
+		data.height = TEXTURE_SIZE;
+
+		uint8_t tint[] = { static_cast<uint8_t>(96 + index * 53 % 160), static_cast<uint8_t>(96 + index * 97 % 160), static_cast<uint8_t>(96 + index * 151 % 160) };
+		uint32_t squareSize = TEXTURE_SIZE / 8;
+
+		std::vector<uint8_t> texels(static_cast<size_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4);
+
+		for (uint32_t y = 0; y < TEXTURE_SIZE; y++)
+		{
+			for (uint32_t x = 0; x < TEXTURE_SIZE; x++)
+			{
+				bool tinted = (x / squareSize + y / squareSize) % 2 == 1;
+				uint8_t* texel = &texels[(static_cast<size_t>(y) * TEXTURE_SIZE + x) * 4];
+
+				texel[0] = tinted ? tint[0] : 255;
+				texel[1] = tinted ? tint[1] : 255;
+				texel[2] = tinted ? tint[2] : 255;
+				texel[3] = 255;
+			}
+		}
+
+		data.levels.push_back(std::move(texels));
+
+		if (index % 2 == 1)
+		{
+			return data;
+		}
+
+		// 2 x 2 box filter, level by level down to 1 x 1
+		uint32_t width = TEXTURE_SIZE;
+		uint32_t height = TEXTURE_SIZE;
+
+		while (width > 1 || height > 1)
+		{
+			uint32_t levelWidth = std::max(1u, width / 2);
+			uint32_t levelHeight = std::max(1u, height / 2);
+
+			const std::vector<uint8_t>& source = data.levels.back();
+			std::vector<uint8_t> level(static_cast<size_t>(levelWidth) * levelHeight * 4);
+
+			for (uint32_t y = 0; y < levelHeight; y++)
+			{
+				for (uint32_t x = 0; x < levelWidth; x++)
+				{
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						unsigned int sum = 0;
+
+						for (uint32_t dy = 0; dy < 2; dy++)
+						{
+							for (uint32_t dx = 0; dx < 2; dx++)
+							{
+								uint32_t sourceX = std::min(x * 2 + dx, width - 1);
+								uint32_t sourceY = std::min(y * 2 + dy, height - 1);
+
+								sum += source[(static_cast<size_t>(sourceY) * width + sourceX) * 4 + c];
+							}
+						}
+
+						level[(static_cast<size_t>(y) * levelWidth + x) * 4 + c] = static_cast<uint8_t>(sum / 4);
+					}
+				}
+			}
+
+			data.levels.push_back(std::move(level));
+
+			width = levelWidth;
+			height = levelHeight;
+		}
+
+		return data;
+	}
+
+	/*
+	* Instance buffer
+	*
+	* The instances are laid out as a near-square grid covering the whole framebuffer, each quad
+	* scaled down to its cell and tinted by its position in the grid.
+	*/
+	void MgeEngine::createInstanceBuffer()
+	{
+		unsigned int count = config.instanceCount;
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		unsigned int columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(count))));
+		unsigned int rows = (count + columns - 1) / columns;
+
+		float cellWidth = 2.0f / columns;
+		float cellHeight = 2.0f / rows;
+
+		std::vector<InstanceData> instances(count);
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float column = static_cast<float>(i % columns);
+			float row = static_cast<float>(i / columns);
+
+			// The quad spans -0.5 .. 0.5, leave a small gap between neighbouring cells
+			instances[i].transform = glm::vec4(-1.0f + (column + 0.5f) * cellWidth, -1.0f + (row + 0.5f) * cellHeight,
+				cellWidth * 0.9f, cellHeight * 0.9f);
+			instances[i].color = glm::vec4(column / columns, row / rows, 1.0f - column / columns, 1.0f);
+		}
+
+		VkDeviceSize bufferSize = sizeof(InstanceData) * instances.size();
+
+		// With GPU culling the cull shader and culled_vert.spv read it as a storage buffer, otherwise it is vertex binding 1
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+			(config.gpuCulling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+		createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instanceBuffer, instanceBufferAllocation);
+
+		// Larger than the staging ring at the top end, the uploader splits it over several batches
+		uploader.uploadBuffer(instanceBuffer, 0, instances.data(), bufferSize);
+
+		if (config.gpuCulling)
+		{
+			createCullBuffers();
+		}
+	}
+
+	void MgeEngine::destroyInstanceBuffer()
+	{
+		if (instanceBuffer != VK_NULL_HANDLE)
+		{
+			allocator.destroyBuffer(instanceBuffer, instanceBufferAllocation);
+			instanceBuffer = VK_NULL_HANDLE;
+		}
+
+		// Every caller has drained the GPU already, so the handles can go back right away
+		if (indirectBuffer != VK_NULL_HANDLE)
+		{
+			bindlessTable.releaseBuffer(instanceBufferHandle);
+			bindlessTable.releaseBuffer(visibleInstanceBufferHandle);
+			instanceBufferHandle = MGE_INVALID_BINDLESS_HANDLE;
+			visibleInstanceBufferHandle = MGE_INVALID_BINDLESS_HANDLE;
+
+			allocator.destroyBuffer(indirectBuffer, indirectBufferAllocation);
+			allocator.destroyBuffer(visibleInstanceBuffer, visibleInstanceBufferAllocation);
+			indirectBuffer = VK_NULL_HANDLE;
+			visibleInstanceBuffer = VK_NULL_HANDLE;
+		}
+	}
+
+	void MgeEngine::setInstanceCount(unsigned int count)
+	{
+		// Only called between benchmark runs, so simply let everything in flight finish
+		vkDeviceWaitIdle(device);
+
+		destroyInstanceBuffer();
+
+		// The cull sets cached for the old buffers must not be handed out for new buffers reusing their handles
+		descriptorAllocator.invalidate();
+
+		config.instanceCount = count;
+
+		createInstanceBuffer();
+
+		uploader.makeAvailable(uploader.flush());
+
+		buildDrawList();
+
+		// Pre-recorded command buffers have the instance count baked in
+		if (!commandBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, commandPool, static_cast<unsigned int>(commandBuffers.size()), commandBuffers.data());
+			commandBuffers.clear();
+		}
+
+		createCommandBuffers();
+	}
+
+	// GPU culling
+
+	void MgeEngine::createCullPipeline()
+	{
+		// 0 = objects (the instance buffer), 1 = indirect command, 2 = visible instances, 3 = camera
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+
+		for (unsigned int binding = 0; binding < bindings.size(); binding++)
+		{
+			bindings[binding].binding = binding;
+			bindings[binding].descriptorType = binding == 3 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[binding].descriptorCount = 1;
+			bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		cullDescriptorSetLayout = descriptorLayoutCache.getLayout(std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()));
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create cull pipeline layout!");
+		}
+
+		auto cullShaderCode = ReadFile(cullShaderFile);
+
+		VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+
+		VkPipelineShaderStageCreateInfo cullShaderStageInfo{};
+		cullShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		cullShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullShaderStageInfo.module = cullShaderModule;
+		cullShaderStageInfo.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = cullShaderStageInfo;
+		pipelineInfo.layout = cullPipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create cull pipeline!");
+		}
+
+		vkDestroyShaderModule(device, cullShaderModule, nullptr);
+	}
+
+	void MgeEngine::createCullBuffers()
+	{
+		// Rewritten with vkCmdUpdateBuffer at the start of every cull pass
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffer, indirectBufferAllocation);
+
+		// Room for every instance to be visible
+		createBuffer(sizeof(unsigned int) * config.instanceCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibleInstanceBuffer, visibleInstanceBufferAllocation);
+
+		instanceBufferHandle = bindlessTable.registerBuffer(instanceBuffer);
+		visibleInstanceBufferHandle = bindlessTable.registerBuffer(visibleInstanceBuffer);
+	}
+
+	void MgeEngine::destroyCullResources()
+	{
+		if (cullPipeline == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		vkDestroyPipeline(device, cullPipeline, nullptr);
+		vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+
+		cullPipeline = VK_NULL_HANDLE;
+	}
+
+	void MgeEngine::recordCulling(VkCommandBuffer commandBuffer, unsigned int profilerSlot, const FrameDescriptors& descriptors)
+	{
+		gpuProfiler.beginScope(commandBuffer, profilerSlot, "cull");
+
+		/*
+		* Every frame reuses the same command and visible list. The render graph makes the previous
+		* frame's indirect draw finish reading them before this pass and the indirect draw wait for
+		* it, only the reset has to land before the shader's atomics.
+		*/
+		VkDrawIndexedIndirectCommand command{};
+		command.indexCount = static_cast<unsigned int>(indices.size());
+		command.instanceCount = 0;
+
+		vkCmdUpdateBuffer(commandBuffer, indirectBuffer, 0, sizeof(command), &command);
+
+		VkBufferMemoryBarrier resetBarrier{};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.buffer = indirectBuffer;
+		resetBarrier.offset = 0;
+		resetBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		// The visible region comes from the slot's camera data
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &descriptors.cull, 1, &descriptors.cameraOffset);
+
+		CullPushConstants pushConstants{};
+		pushConstants.objectCount = config.instanceCount;
+
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+
+		vkCmdDispatch(commandBuffer, (config.instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+		gpuProfiler.endScope(commandBuffer, profilerSlot);
+	}
+
+	void MgeEngine::createFrameResources()
+	{
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+		frameResources.resize(framesInFlight);
+
+		for (auto& frame : frameResources)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;	// Buffers live for one frame only
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create frame command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = frame.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate frame command buffer!");
+			}
+
+			// Command pools are externally synchronized, so every worker gets its own per frame
+			frame.workerCommandPools.resize(maxRecordingThreads);
+			frame.workerCommandBuffers.resize(maxRecordingThreads);
+
+			for (unsigned int worker = 0; worker < maxRecordingThreads; worker++)
+			{
+				if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.workerCommandPools[worker]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create worker command pool!");
+				}
+
+				VkCommandBufferAllocateInfo secondaryInfo{};
+				secondaryInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				secondaryInfo.commandPool = frame.workerCommandPools[worker];
+				secondaryInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				secondaryInfo.commandBufferCount = 1;
+
+				if (vkAllocateCommandBuffers(device, &secondaryInfo, &frame.workerCommandBuffers[worker]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to allocate worker command buffer!");
+				}
+			}
+		}
+	}
+
+	void MgeEngine::destroyFrameResources()
+	{
+		// Destroying the pool frees its command buffer as well
+		for (auto& frame : frameResources)
+		{
+			for (auto workerPool : frame.workerCommandPools)
+			{
+				vkDestroyCommandPool(device, workerPool, nullptr);
+			}
+
+			vkDestroyCommandPool(device, frame.commandPool, nullptr);
+		}
+
+		frameResources.clear();
+	}
+
+	void MgeEngine::createCommandBuffers()
+	{
+		// Per-frame recording records into the frame resources in drawFrame(), nothing to pre-record
+		if (config.commandRecording != MgeCommandRecording::PreRecorded)
+		{
+			return;
+		}
+
+		commandBuffers.resize(swapChainImages.size());
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<unsigned int>(commandBuffers.size());
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate command buffers");
+		}
+
+		for (unsigned long long i = 0; i < commandBuffers.size(); i++)
+		{
+			VkCommandBufferBeginInfo beginInfo{ };
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed t o begin recording command buffer!");
+			}
+
+			// Pre-recorded buffers use the image index as slot, their sets live as long as they do
+			unsigned int slot = static_cast<unsigned int>(i);
+
+			recordCommandBuffer(commandBuffers[i], slot, slot, beginFrameDescriptors(slot));
+
+			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to record command buffer");
+			}
+
+		}
+	}
+
+	MgeEngine::FrameDescriptors MgeEngine::beginFrameDescriptors(unsigned int slot)
+	{
+		descriptorAllocator.beginFrame(slot);
+
+		FrameDescriptors descriptors{};
+		descriptors.cameraOffset = uniformRing.getSlotOffset(slot);
+
+		// Both point at the whole slot range of the ring, the dynamic offset picks the slot
+		descriptors.camera = descriptorAllocator.allocate(cameraDescriptorSetLayout, {
+			MgeDescriptorWrite::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniformRing.getBuffer(), 0, sizeof(CameraData)) });
+
+		if (config.gpuCulling)
+		{
+			descriptors.cull = descriptorAllocator.allocate(cullDescriptorSetLayout, {
+				MgeDescriptorWrite::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instanceBuffer),
+				MgeDescriptorWrite::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, indirectBuffer),
+				MgeDescriptorWrite::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, visibleInstanceBuffer),
+				MgeDescriptorWrite::buffer(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniformRing.getBuffer(), 0, sizeof(CameraData)) });
+		}
+
+		return descriptors;
+	}
+
+	// Records the frame's draw commands between vkBeginCommandBuffer and vkEndCommandBuffer
+
+	void MgeEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, unsigned int imageIndex, unsigned int profilerSlot,
+		const FrameDescriptors& descriptors, const std::vector<VkCommandBuffer>& secondaryCommandBuffers)
+	{
+		gpuProfiler.beginFrame(commandBuffer, profilerSlot);
+
+		buildFrameGraph(imageIndex, profilerSlot, descriptors, secondaryCommandBuffers);
+
+		renderGraph.compile(deletionQueue, submissionSerial);
+		renderGraph.execute(commandBuffer);
+	}
+
+	/*
+	* Frame graph
+	*
+	*   cull     (GPU culling only)   resets the indirect draw, compacts the visible instances
+	*   main                          draws the draw list into the scene target
+	*   upscale  (render scale only)  blits the scene target to the swapchain image
+	*
+	* Without a render scale the main pass draws straight into the swapchain image. The graph puts
+	* the barriers between the passes and the swapchain image's transitions in and out of the frame.
+	*/
+	void MgeEngine::buildFrameGraph(unsigned int imageIndex, unsigned int profilerSlot, const FrameDescriptors& descriptors,
+		const std::vector<VkCommandBuffer>& secondaryCommandBuffers)
+	{
+		renderGraph.reset();
+
+		// The acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, the old contents are never read
+		MgeRenderResource target = renderGraph.importImage("swapchain", swapChainImages[imageIndex], swapChainImageViews[imageIndex],
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, getFinalImageLayout());
+
+		renderGraph.markOutput(target);
+
+		bool upscale = usesRenderScale();
+
+		MgeRenderResource scene = target;
+
+		if (upscale)
+		{
+			VkExtent2D renderExtent = getRenderExtent();
+
+			scene = renderGraph.createImage("scene_color",
+				{ swapChainImageFormat, renderExtent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT });
+		}
+
+		MgeRenderResource indirectDraw = 0;
+		MgeRenderResource visibleInstances = 0;
+
+		if (config.gpuCulling)
+		{
+			// Last read by the previous frame's indirect draw
+			indirectDraw = renderGraph.importBuffer("indirect_draw", indirectBuffer, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_NONE);
+			visibleInstances = renderGraph.importBuffer("visible_instances", visibleInstanceBuffer, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_NONE);
+
+			renderGraph.addPass("cull", [this, profilerSlot, &descriptors](VkCommandBuffer commandBuffer)
+				{
+					recordCulling(commandBuffer, profilerSlot, descriptors);
+				})
+				.write(indirectDraw, VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_WRITE_BIT)
+				.read(indirectDraw, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT)
+				.write(visibleInstances, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT);
+		}
+
+		auto mainPass = renderGraph.addPass("main", [this, imageIndex, profilerSlot, scene, &descriptors, &secondaryCommandBuffers](VkCommandBuffer commandBuffer)
+			{
+				// Secondaries may only run inside the statistics query when they can inherit it
+				gpuProfiler.beginScope(commandBuffer, profilerSlot, "main_pass", secondaryCommandBuffers.empty() || inheritedQueriesEnabled);
+
+				// The pass contents come either inline or entirely from the workers' secondary command buffers
+				beginMainPass(commandBuffer, imageIndex, renderGraph.getImageView(scene), !secondaryCommandBuffers.empty());
+
+				if (secondaryCommandBuffers.empty())
+				{
+					recordDraws(commandBuffer, 0, drawList.size(), descriptors);
+				}
+				else
+				{
+					vkCmdExecuteCommands(commandBuffer, static_cast<unsigned int>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+				}
+
+				endMainPass(commandBuffer);
+
+				gpuProfiler.endScope(commandBuffer, profilerSlot);
+			});
+
+		mainPass.write(scene, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		if (config.gpuCulling)
+		{
+			mainPass.read(indirectDraw, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT)
+				.read(visibleInstances, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+		}
+
+		if (upscale)
+		{
+			renderGraph.addPass("upscale", [this, profilerSlot, scene, target](VkCommandBuffer commandBuffer)
+				{
+					gpuProfiler.beginScope(commandBuffer, profilerSlot, "upscale");
+
+					VkExtent2D renderExtent = getRenderExtent();
+
+					VkImageBlit region{};
+					region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					region.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+					region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					region.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+
+					vkCmdBlitImage(commandBuffer, renderGraph.getImage(scene), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						renderGraph.getImage(target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+
+					gpuProfiler.endScope(commandBuffer, profilerSlot);
+				})
+				.read(scene, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+				.write(target, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		}
+	}
+
+	void MgeEngine::beginMainPass(VkCommandBuffer commandBuffer, unsigned int imageIndex, VkImageView target, bool secondaryContents)
+	{
+		VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+
+		// The render graph already moved the target to COLOR_ATTACHMENT_OPTIMAL, neither backend transitions it
+		if (config.renderBackend == MgeRenderBackend::RenderPass)
+		{
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = renderPass;
+			renderPassInfo.framebuffer = swapChainFrameBuffers[imageIndex];
+			renderPassInfo.renderArea.offset = { 0,0 };
+			renderPassInfo.renderArea.extent = swapChainExtent;
+			renderPassInfo.clearValueCount = 1;
+			renderPassInfo.pClearValues = &clearColor;
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+				secondaryContents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+			return;
+		}
+
+		VkRenderingAttachmentInfo colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		colorAttachment.imageView = target;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearColor;
+
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.flags = secondaryContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+		renderingInfo.renderArea.offset = { 0,0 };
+		renderingInfo.renderArea.extent = getRenderExtent();
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void MgeEngine::endMainPass(VkCommandBuffer commandBuffer)
+	{
+		if (config.renderBackend == MgeRenderBackend::RenderPass)
+		{
+			vkCmdEndRenderPass(commandBuffer);
+		}
+		else
+		{
+			vkCmdEndRendering(commandBuffer);
+		}
+	}
+
+	VkImageLayout MgeEngine::getFinalImageLayout() const
+	{
+		// PRESENT_SRC_KHR needs VK_KHR_swapchain, offscreen images are left ready to be copied out instead
+		return config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	bool MgeEngine::usesRenderScale() const
+	{
+		return config.renderScale != 1.0f;
+	}
+
+	VkExtent2D MgeEngine::getRenderExtent() const
+	{
+		if (!usesRenderScale())
+		{
+			return swapChainExtent;
+		}
+
+		return { std::max(1u, static_cast<uint32_t>(swapChainExtent.width * config.renderScale + 0.5f)),
+			std::max(1u, static_cast<uint32_t>(swapChainExtent.height * config.renderScale + 0.5f)) };
+	}
+
+	void MgeEngine::recordDraws(VkCommandBuffer commandBuffer, size_t first, size_t count, const FrameDescriptors& descriptors)
+	{
+		// bind graphic pipeline
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+		// Camera and bindless table in one bind, the dynamic offset selects the frame's camera data
+		VkDescriptorSet descriptorSets[] = { descriptors.camera, bindlessTable.getSet() };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 1, &descriptors.cameraOffset);
+
+		// viewport and scissor are dynamic state, set them for the current extent (scaled by the render scale)
+		VkExtent2D renderExtent = getRenderExtent();
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(renderExtent.width);
+		viewport.height = static_cast<float>(renderExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0,0 };
+		scissor.extent = renderExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Binding 1 only exists in the instanced pipeline without GPU culling
+		VkBuffer vertexBuffers[] = { vertexBuffer, instanceBuffer };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, instanceBuffer != VK_NULL_HANDLE && !config.gpuCulling ? 2 : 1, vertexBuffers, offsets);
+
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+		for (size_t i = first; i < first + count; i++)
+		{
+			const DrawItem& draw = drawList[i];
+
+			// The instanced vertex shader takes its transforms from the instance buffer, only the fragment shader reads these then
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &draw.constants);
+
+			if (config.gpuCulling)
+			{
+				// The cull pass wrote how many instances get drawn
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else
+			{
+				vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+			}
+		}
+	}
+
+	std::vector<VkCommandBuffer> MgeEngine::recordSecondaryCommandBuffers(FrameResources& frame, unsigned int imageIndex, const FrameDescriptors& descriptors)
+	{
+		unsigned int threadCount = activeRecordingThreads;
+		size_t drawTotal = drawList.size();
+
+		// Dynamic rendering has no framebuffer, the secondaries inherit the attachment formats instead
+		VkFramebuffer frameBuffer = config.renderBackend == MgeRenderBackend::RenderPass ? swapChainFrameBuffers[imageIndex] : VK_NULL_HANDLE;
+
+		MgeThreadPool::Task recordSlice = [&](unsigned int worker)
+		{
+			// Contiguous slices in worker order keep the draw order identical to inline recording
+			size_t first = drawTotal * worker / threadCount;
+			size_t last = drawTotal * (worker + 1) / threadCount;
+
+			VkCommandBuffer commandBuffer = frame.workerCommandBuffers[worker];
+
+			vkResetCommandPool(device, frame.workerCommandPools[worker], 0);
+
+			VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{};
+			inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+			inheritanceRenderingInfo.colorAttachmentCount = 1;
+			inheritanceRenderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+			inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+			VkCommandBufferInheritanceInfo inheritanceInfo{};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = renderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = frameBuffer;
+
+			// The main_pass scope keeps its statistics query open around vkCmdExecuteCommands
+			inheritanceInfo.pipelineStatistics = inheritedQueriesEnabled ? gpuProfiler.getStatisticsFlags() : 0;
+
+			if (config.renderBackend == MgeRenderBackend::Dynamic)
+			{
+				inheritanceInfo.pNext = &inheritanceRenderingInfo;
+			}
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to begin recording secondary command buffer!");
+			}
+
+			recordDraws(commandBuffer, first, last - first, descriptors);
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+		};
+
+		recordingPool.run(threadCount, recordSlice);
+
+		return std::vector<VkCommandBuffer>(frame.workerCommandBuffers.begin(), frame.workerCommandBuffers.begin() + threadCount);
+	}
+
+	/*
+	* Draw list
+	*
+	* Every draw is the quad from the index buffer, moved into its own cell of a near-square grid
+	* by its push constant transform and tinted by the next entry of the bindless material table.
+	* A draw count of 1 gives the original full-screen quad.
+	*/
+	void MgeEngine::buildDrawList()
+	{
+		drawList.clear();
+
+		// Instanced draws cover the whole framebuffer, the instance transforms place the quads
+		if (config.instanceCount > 0)
+		{
+			// With GPU culling one indirect draw covers every instance
+			unsigned int drawCount = config.gpuCulling ? 1 : std::clamp(config.drawCount, 1u, config.instanceCount);
+
+			for (unsigned int i = 0; i < drawCount; i++)
+			{
+				DrawItem draw{};
+				draw.constants.transform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+				draw.constants.materialBuffer = materialBufferHandle;
+				draw.constants.material = 0;
+				draw.constants.texture = textureManager.getFallbackHandle();
+				draw.constants.instanceBuffer = instanceBufferHandle;
+				draw.constants.visibleInstances = visibleInstanceBufferHandle;
+				draw.indexCount = static_cast<unsigned int>(indices.size());
+				draw.firstIndex = 0;
+				draw.vertexOffset = 0;
+				draw.firstInstance = static_cast<unsigned int>(static_cast<unsigned long long>(config.instanceCount) * i / drawCount);
+				draw.instanceCount = static_cast<unsigned int>(static_cast<unsigned long long>(config.instanceCount) * (i + 1) / drawCount) - draw.firstInstance;
+
+				drawList.push_back(draw);
+			}
+
+			return;
+		}
+
+		unsigned int count = std::max(1u, config.drawCount);
+		unsigned int columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(count))));
+		unsigned int rows = (count + columns - 1) / columns;
+
+		drawList.reserve(count);
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			// Cell size and centre in world space (-1 .. 1), the quad fills the middle half of its cell
+			float cellWidth = 2.0f / columns;
+			float cellHeight = 2.0f / rows;
+
+			DrawItem draw{};
+			draw.constants.transform = glm::vec4(-1.0f + (i % columns + 0.5f) * cellWidth, -1.0f + (i / columns + 0.5f) * cellHeight,
+				cellWidth * 0.5f, cellHeight * 0.5f);
+			draw.constants.materialBuffer = materialBufferHandle;
+			draw.constants.material = i % static_cast<unsigned int>(materials.size());
+			draw.constants.texture = textureManager.getFallbackHandle();
+			draw.indexCount = static_cast<unsigned int>(indices.size());
+			draw.firstIndex = 0;
+			draw.vertexOffset = 0;
+			draw.firstInstance = 0;
+			draw.instanceCount = 1;
+
+			drawList.push_back(draw);
+		}
+	}
+
+	void MgeEngine::createSyncObjects()
+	{
+		imageSubmissions.assign(swapChainImages.size(), 0);
+
+		createFrameSyncObjects();
+
+		// Serial 0 means "nothing submitted yet", so the timeline starts out complete
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &timelineInfo;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create frame timeline semaphore!");
+		}
+
+	}
+
+	void MgeEngine::createFrameSyncObjects()
+	{
+		imageAvailableSemaphores.resize(framesInFlight);
+		renderFinishedSemaphores.resize(framesInFlight);
+		frameSubmissions.assign(framesInFlight, 0);
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		// Acquire and present only take binary semaphores, those stay per frame
+		for (unsigned int i = 0; i < framesInFlight; i++)
+		{
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create synchronization objects for a frame!");
+			}
+		}
+	}
+
+	void MgeEngine::destroyFrameSyncObjects()
+	{
+		for (unsigned long long i = 0; i < imageAvailableSemaphores.size(); i++)
+		{
+			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+		}
+
+		imageAvailableSemaphores.clear();
+		renderFinishedSemaphores.clear();
+		frameSubmissions.clear();
+	}
+
+	unsigned long long MgeEngine::getCompletedSubmission()
+	{
+		uint64_t value = 0;
+
+		if (vkGetSemaphoreCounterValue(device, frameTimeline, &value) == VK_SUCCESS)
+		{
+			completedSubmission = std::max<unsigned long long>(completedSubmission, value);
+		}
+
+		return completedSubmission;
+	}
+
+	void MgeEngine::waitForSubmission(unsigned long long serial)
+	{
+		if (serial <= completedSubmission)
+		{
+			return;
+		}
+
+		uint64_t value = serial;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &frameTimeline;
+		waitInfo.pValues = &value;
+
+		if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait for the frame timeline!");
+		}
+
+		completedSubmission = serial;
+	}
+
+	bool MgeEngine::drawFrame()
+	{
+		auto frameWaitStart = MgeBenchmark::Clock::now();
+
+		// Wait until this frame slot's previous submission has finished
+		waitForSubmission(frameSubmissions[currentFrame]);
+
+		benchmark.addSample("frame_wait_ms", MgeBenchmark::millisecondsSince(frameWaitStart));
+
+		collectPresents();
+
+		// The counter may already be further along than the value just waited for
+		deletionQueue.flush(getCompletedSubmission());
+
+		uploader.collect();
+
+		// Never waits, finished uploads are swapped in and the draws pick up the new handles
+		updateTextures();
+
+		bool perFrameRecording = config.commandRecording == MgeCommandRecording::PerFrame;
+
+		// Per-frame recording profiles into the frame's own slot, which the wait above just freed
+		if (perFrameRecording)
+		{
+			collectGpuProfile(static_cast<unsigned int>(currentFrame));
+		}
+
+		unsigned int imageIndex;
+
+		if (config.headless)
+		{
+			// No swapchain to acquire from, just rotate through the offscreen images
+			imageIndex = offscreenImageIndex;
+			offscreenImageIndex = (offscreenImageIndex + 1) % static_cast<unsigned int>(swapChainImages.size());
+		}
+		else
+		{
+			auto acquireStart = MgeBenchmark::Clock::now();
+
+			VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+			benchmark.addSample("acquire_ms", MgeBenchmark::millisecondsSince(acquireStart));
+
+			if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				// No frame this time, still keep the window responsive
+				sampleInput();
+
+				auto recreateStart = MgeBenchmark::Clock::now();
+
+				recreateSwapChain();
+
+				benchmark.addSample("swapchain_recreate_ms", MgeBenchmark::millisecondsSince(recreateStart));
+				return false;
+			}
+			else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+			{
+				throw std::runtime_error("Failed to acquire swap image!");
 			}
 
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFrameBuffers[i];
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
+			// Acquire blocks until a present has retired an image, check it while it is fresh
+			collectPresents();
+		}
+
+
+		// The image may still be in use by an older frame from another slot
+		waitForSubmission(imageSubmissions[imageIndex]);
+
+		// The image's previous submission has finished, so its queries can be read without waiting
+		if (!perFrameRecording)
+		{
+			collectGpuProfile(imageIndex);
+		}
+
+		VkCommandBuffer commandBuffer;
+		unsigned int profilerSlot;
+
+		if (perFrameRecording)
+		{
+			FrameResources& frame = frameResources[currentFrame];
+
+			commandBuffer = frame.commandBuffer;
+			profilerSlot = static_cast<unsigned int>(currentFrame);
+
+			auto recordStart = MgeBenchmark::Clock::now();
+
+			// The frame's previous submission has finished, nothing in this pool is in use any more
+			vkResetCommandPool(device, frame.commandPool, 0);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to begin recording frame command buffer!");
+			}
+
+			// The wait above freed the slot's descriptor sets as well
+			FrameDescriptors descriptors = beginFrameDescriptors(profilerSlot);
+
+			if (activeRecordingThreads > 0)
+			{
+				recordCommandBuffer(commandBuffer, imageIndex, profilerSlot, descriptors,
+					recordSecondaryCommandBuffers(frame, imageIndex, descriptors));
+			}
+			else
+			{
+				recordCommandBuffer(commandBuffer, imageIndex, profilerSlot, descriptors);
+			}
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to record frame command buffer!");
+			}
+
+			benchmark.addSample("record_ms", MgeBenchmark::millisecondsSince(recordStart));
+		}
+		else
+		{
+			commandBuffer = commandBuffers[imageIndex];
+			profilerSlot = imageIndex;
+		}
+
+		/*
+		* Late latching: every wait of the frame (slot, acquire, image) and the recording are behind us,
+		* so sample input now. The camera only reaches the command buffer through the uniform ring,
+		* which is written after recording, so even this frame's draws see the newest input.
+		*/
+		sampleInput();
+
+		// The slot's previous submission has finished (frame or image wait above), its ring region is free
+		writeCameraData(profilerSlot);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+		// Headless frames have no acquire to wait for and no present to signal
+
+		VkSemaphore waitSemephores[] = { imageAvailableSemaphores[currentFrame] };
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		submitInfo.waitSemaphoreCount = config.headless ? 0 : 1;
+		submitInfo.pWaitSemaphores = waitSemephores;
+		submitInfo.pWaitDstStageMask = waitStages;
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		unsigned long long serial = submissionSerial + 1;
+
+		// The timeline goes first so headless frames (no present semaphore) can just use a count of 1
+		VkSemaphore signalSemaphores[] = { frameTimeline, renderFinishedSemaphores[currentFrame] };
+		uint64_t signalValues[] = { serial, 0 };	// The value of a binary semaphore is ignored
+		submitInfo.signalSemaphoreCount = config.headless ? 1 : 2;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+		submitInfo.pNext = &timelineSubmitInfo;
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit draw command buffer");
+		}
+
+		gpuProfiler.markSubmitted(profilerSlot);
+
+		submissionSerial = serial;
+		frameSubmissions[currentFrame] = serial;
+		imageSubmissions[imageIndex] = serial;
+
+		framesRendered++;
+
+		if (config.headless)
+		{
+			currentFrame = (currentFrame + 1) % framesInFlight;
+			return true;
+		}
+
+		benchmark.addSample("input_to_submit_ms", MgeBenchmark::millisecondsSince(inputSampleTime));
 
-			VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
+		// submit result to swapchain and be able to show on screen
+
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+
+		// Speficy swapchain to present images to and index for each swapchain
+		VkSwapchainKHR swapChains[] = { swapChain };
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = swapChains;
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		presentInfo.pImageIndices = &imageIndex;
 
-			// bind graphic pipeline
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-			
-			VkBuffer vertexBuffers[] = { vertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-			// vkCmdDraw(commandBuffers[i], static_cast<unsigned int>(vertices.size()), 1, 0, 0);
+		// Tag the present so collectPresents() can tell when it reached the screen
+		VkPresentIdKHR presentIdInfo{};
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = 1;
+		presentIdInfo.pPresentIds = &presentId;
 
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<unsigned int>(indices.size()), 1, 0, 0, 0);
+		if (presentWaitEnabled)
+		{
+			presentId++;
+			presentInfo.pNext = &presentIdInfo;
+		}
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+		auto presentStart = MgeBenchmark::Clock::now();
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to record command buffer");
-			}
+		VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
+		benchmark.addSample("present_ms", MgeBenchmark::millisecondsSince(presentStart));
+
+		if (presentWaitEnabled)
+		{
+			pendingPresents.push_back({ presentId, inputSampleTime });
+		}
+		else
+		{
+			// Without present wait, the closest we get is the present call returning
+			benchmark.addSample("input_to_queue_present_ms", MgeBenchmark::millisecondsSince(inputSampleTime));
 		}
-	}
 
-	void MgeEngine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-	{
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
-		allocInfo.commandBufferCount = 1;
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResize)
+		{
+			frameBufferResize = false;
 
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+			auto recreateStart = MgeBenchmark::Clock::now();
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			recreateSwapChain();
 
-		VkBufferCopy copyRegion{};
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-		vkEndCommandBuffer(commandBuffer);
+			benchmark.addSample("swapchain_recreate_ms", MgeBenchmark::millisecondsSince(recreateStart));
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			throw std::runtime_error("Failed to present swap image!");
+		}
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+		collectPresents();
 
+		// move to next frame
+		currentFrame = (currentFrame + 1) % framesInFlight;
 
+		return true;
 	}
-	
-	void MgeEngine::createSyncObjects()
+
+	void MgeEngine::sampleInput()
 	{
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+		if (config.headless)
+		{
+			return;
+		}
 
-		VkSemaphoreCreateInfo semaphoreInfo{};
-		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		glfwPollEvents();
+
+		updateCamera();
 
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		inputSampleTime = MgeBenchmark::Clock::now();
+	}
 
-		for (unsigned long long i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	void MgeEngine::collectPresents()
+	{
+		/*
+		* vkWaitForPresentKHR needs the swapchain externally synchronized, so rather than blocking on it
+		* from another thread we poll it with a zero timeout on this one. A present is only seen at
+		* the next poll, which makes the measured latency up to one frame too long at worst.
+		*/
+		while (!pendingPresents.empty())
 		{
-			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+			VkResult result = waitForPresent(device, swapChain, pendingPresents.front().id, 0);
+
+			if (result == VK_TIMEOUT)
 			{
-				throw std::runtime_error("Failed to create synchronization objects for a frame!");
+				break;
+			}
+
+			if (result != VK_SUCCESS)
+			{
+				// Out of date or surface lost, these presents will never be reported
+				pendingPresents.clear();
+				break;
 			}
+
+			benchmark.addSample("input_to_present_ms", MgeBenchmark::millisecondsSince(pendingPresents.front().inputTime));
+			pendingPresents.pop_front();
+		}
+	}
+	
+	// end of GPU
+
+	// Present profile
+
+	void MgeEngine::setPresentProfile(MgePresentProfile profile)
+	{
+		if (profile == config.presentProfile)
+		{
+			pendingPresentProfile.reset();
+			return;
 		}
 
+		pendingPresentProfile = profile;
 	}
 
-	void MgeEngine::drawFrame()
+	void MgeEngine::applyPresentProfile()
 	{
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		MgePresentProfile profile = pendingPresentProfile.value();
+		pendingPresentProfile.reset();
 
-		unsigned int imageIndex;
+		/*
+		* Switching is rare and changes how many frames can be in flight, so drain the GPU instead of
+		* retiring every per-frame object through the deletion queue.
+		*/
+		vkDeviceWaitIdle(device);
+
+		deletionQueue.flush(getCompletedSubmission());
+
+		// Per-frame recording profiles into the frame slots, read them before the slot count changes
+		if (config.commandRecording == MgeCommandRecording::PerFrame)
+		{
+			for (unsigned int frame = 0; frame < framesInFlight; frame++)
+			{
+				collectGpuProfile(frame);
+			}
+		}
 
-		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		config.presentProfile = profile;
+		framesInFlight = getProfileFramesInFlight(profile);
+		currentFrame = 0;
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		destroyFrameSyncObjects();
+		destroyFrameResources();
+
+		createFrameResources();
+		createFrameSyncObjects();
+
+		// Headless runs keep their offscreen images, only the frames in flight change
+		if (!config.headless)
 		{
 			recreateSwapChain();
-			return;
 		}
-		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+
+		std::cout << "Present profile : " << presentProfileName(profile) << " (" << framesInFlight << " frames in flight";
+
+		if (!config.headless)
 		{
-			throw std::runtime_error("Failed to acquire swap image!");
+			std::cout << ", " << presentModeName(swapChainPresentMode) << ", " << swapChainImages.size() << " images";
 		}
 
-			
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+		std::cout << ")" << std::endl;
+	}
+
+	unsigned int MgeEngine::getProfileFramesInFlight(MgePresentProfile profile)
+	{
+		switch (profile)
 		{
-			vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		case MgePresentProfile::LowLatency: return 1;
+		case MgePresentProfile::Throughput: return 3;
+		default: return 2;
 		}
+	}
 
-		// match inflight images to the current frame
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+	const char* MgeEngine::presentProfileName(MgePresentProfile profile)
+	{
+		switch (profile)
+		{
+		case MgePresentProfile::Default: return "default";
+		case MgePresentProfile::LowLatency: return "low_latency";
+		case MgePresentProfile::Throughput: return "throughput";
+		default: return "unknown";
+		}
+	}
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// GPU profiling
 
-		VkSemaphore waitSemephores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemephores;
-		submitInfo.pWaitDstStageMask = waitStages;
+	unsigned int MgeEngine::getRequiredFrameSlots() const
+	{
+		return std::max({ MIN_FRAME_SLOTS, framesInFlight, static_cast<unsigned int>(swapChainImages.size()) });
+	}
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	void MgeEngine::resizeFrameSlots()
+	{
+		/*
+		* Rare (a swapchain with more images than any before), so drain the GPU instead of retiring the
+		* query pools, the ring buffer and the descriptor pools through the deletion queue.
+		*/
+		vkDeviceWaitIdle(device);
 
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		frameSlotCount = getRequiredFrameSlots();
 
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
+		gpuProfiler.destroy();
+		gpuProfiler.init(physicalDevice, device, findQueueFamilies(physicalDevice).graphicsFamily.value(), pipelineStatisticsEnabled, frameSlotCount);
 
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+		uniformRing.destroy();
+		uniformRing.init(physicalDevice, allocator, frameSlotCount, UNIFORM_RING_SLOT_SIZE);
+
+		// The cached sets point at the old ring buffer
+		descriptorAllocator.destroy();
+		descriptorAllocator.init(device, frameSlotCount);
+	}
+
+	void MgeEngine::collectGpuProfile(unsigned int slot)
+	{
+		if (!gpuProfiler.collect(slot))
 		{
-			throw std::runtime_error("Failed to submit draw command buffer");
+			return;
 		}
 
-		// submit result to swapchain and be able to show on screen
-
-		VkPresentInfoKHR presentInfo{};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		for (const auto& scope : gpuProfiler.getResults())
+		{
+			benchmark.addSample("gpu_" + scope.name + "_ms", scope.gpuMilliseconds);
 
-		// Speficy swapchain to present images to and index for each swapchain
-		VkSwapchainKHR swapChains[] = { swapChain };
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = swapChains;
+			if (scope.hasStatistics)
+			{
+				benchmark.addSample("gpu_" + scope.name + "_vs_invocations", static_cast<double>(scope.vertexInvocations));
+				benchmark.addSample("gpu_" + scope.name + "_fs_invocations", static_cast<double>(scope.fragmentInvocations));
+			}
+		}
+	}
 
-		presentInfo.pImageIndices = &imageIndex;
+	// Benchmark
 
-		result = vkQueuePresentKHR(presentQueue, &presentInfo);
+	void MgeEngine::reportBenchmark(const std::string& reportFile)
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		benchmark.setInfo("device", deviceProperties.deviceName);
+		benchmark.setInfo("mode", config.headless ? "headless" : "windowed");
+		benchmark.setInfo("present_mode", config.headless ? "none" : presentModeName(swapChainPresentMode));
+		benchmark.setInfo("present_profile", presentProfileName(config.presentProfile));
+		benchmark.setInfo("frames_in_flight", std::to_string(framesInFlight));
+		benchmark.setInfo("command_recording", commandRecordingName(config.commandRecording));
+		benchmark.setInfo("render_backend", renderBackendName(config.renderBackend));
+		benchmark.setInfo("render_scale", std::to_string(config.renderScale));
+		benchmark.setInfo("init_vulkan_ms", std::to_string(initVulkanMilliseconds));
+		benchmark.setInfo("recording_threads", std::to_string(activeRecordingThreads));
+		benchmark.setInfo("draws", std::to_string(drawList.size()));
+		benchmark.setInfo("instances", std::to_string(config.instanceCount));
+		benchmark.setInfo("vertex_stride", std::to_string(config.packedVertices ? PackedVertexLayout::stride : VertexLayout::stride));
+		benchmark.setInfo("gpu_culling", config.gpuCulling ? "on" : "off");
+		benchmark.setInfo("present_wait", presentWaitEnabled ? "on" : "off");
+		benchmark.setInfo("frame_rate_cap", std::to_string(frameLimiter.getFrameRate()));
+
+		MgeAllocator::Stats memoryStats = allocator.getStats();
+		benchmark.setInfo("gpu_memory_used_bytes", std::to_string(memoryStats.usedBytes));
+		benchmark.setInfo("gpu_memory_reserved_bytes", std::to_string(memoryStats.reservedBytes));
+		benchmark.setInfo("gpu_memory_blocks", std::to_string(memoryStats.blockCount));
+		benchmark.setInfo("gpu_memory_dedicated", std::to_string(memoryStats.dedicatedCount));
+		benchmark.setInfo("upload_queue", uploader.usesDedicatedQueue() ? "dedicated" : "graphics");
+		benchmark.setInfo("upload_batches", std::to_string(uploader.getBatchCount()));
+		benchmark.setInfo("uploaded_bytes", std::to_string(uploader.getUploadedBytes()));
+
+		const MgeDescriptorAllocator::Stats& descriptorStats = descriptorAllocator.getStats();
+		benchmark.setInfo("descriptor_sets_allocated", std::to_string(descriptorStats.setsAllocated));
+		benchmark.setInfo("descriptor_cache_hits", std::to_string(descriptorStats.cacheHits));
+		benchmark.setInfo("descriptor_pool_resets", std::to_string(descriptorStats.poolResets));
+		benchmark.setInfo("descriptor_pools", std::to_string(descriptorStats.poolsCreated));
+		benchmark.setInfo("descriptor_set_layouts", std::to_string(descriptorLayoutCache.getLayoutCount()));
+		benchmark.setInfo("bindless_textures", std::to_string(bindlessTable.getTextureCount()));
+		benchmark.setInfo("bindless_buffers", std::to_string(bindlessTable.getBufferCount()));
+
+		MgeTextureManager::Stats textureStats = textureManager.getStats();
+		benchmark.setInfo("textures", std::to_string(textureStats.textureCount));
+		benchmark.setInfo("textures_resident", std::to_string(textureStats.residentCount));
+		benchmark.setInfo("texture_resident_bytes", std::to_string(textureStats.residentBytes));
+		benchmark.setInfo("texture_budget_bytes", std::to_string(textureStats.budgetBytes));
+		benchmark.setInfo("textures_streamed_in", std::to_string(textureStats.streamedIn));
+		benchmark.setInfo("textures_streamed_out", std::to_string(textureStats.streamedOut));
+		benchmark.setInfo("texture_uploaded_bytes", std::to_string(textureStats.uploadedBytes));
+
+		const MgeRenderGraph::Stats& graphStats = renderGraph.getStats();
+		benchmark.setInfo("render_graph_passes", std::to_string(graphStats.passCount));
+		benchmark.setInfo("render_graph_culled_passes", std::to_string(graphStats.culledPassCount));
+		benchmark.setInfo("render_graph_barrier_batches", std::to_string(graphStats.barrierBatchCount));
+		benchmark.setInfo("render_graph_image_barriers", std::to_string(graphStats.imageBarrierCount));
+		benchmark.setInfo("render_graph_buffer_barriers", std::to_string(graphStats.bufferBarrierCount));
+		benchmark.setInfo("transient_images", std::to_string(graphStats.transientImageCount));
+		benchmark.setInfo("transient_image_bytes", std::to_string(graphStats.transientImageBytes));
+		benchmark.setInfo("transient_memory_bytes", std::to_string(graphStats.transientMemoryBytes));
+		benchmark.setInfo("image_count", std::to_string(swapChainImages.size()));
+		benchmark.setInfo("extent", std::to_string(swapChainExtent.width) + "x" + std::to_string(swapChainExtent.height));
+		benchmark.setInfo("validation_layers", enableValidationLayers ? "on" : "off");
+
+		benchmark.printReport(std::cout);
+		benchmark.writeJsonReport(reportFile);
+
+		std::cout << "Benchmark report written to " << reportFile << std::endl;
+	}
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResize)
+	const char* MgeEngine::presentModeName(VkPresentModeKHR presentMode)
+	{
+		switch (presentMode)
 		{
-			frameBufferResize = false;
-
-			recreateSwapChain();
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+		default: return "unknown";
 		}
-		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	}
+
+	const char* MgeEngine::commandRecordingName(MgeCommandRecording recording)
+	{
+		switch (recording)
 		{
-			throw std::runtime_error("Failed to present swap image!");
+		case MgeCommandRecording::PreRecorded: return "prerecorded";
+		case MgeCommandRecording::PerFrame: return "perframe";
+		default: return "unknown";
 		}
+	}
 
-		// move to next frame
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-
+	const char* MgeEngine::renderBackendName(MgeRenderBackend backend)
+	{
+		switch (backend)
+		{
+		case MgeRenderBackend::RenderPass: return "renderpass";
+		case MgeRenderBackend::Dynamic: return "dynamic";
+		default: return "unknown";
+		}
 	}
-	
-	// end of GPU
 
 	VkShaderModule MgeEngine::createShaderModule(const std::vector<char>& code)
 	{
@@ -1370,41 +3704,92 @@ namespace mge {
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
 		}
 
-		vkFreeCommandBuffers(device, commandPool, static_cast<unsigned int>(commandBuffers.size()), commandBuffers.data());
-
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
-
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		if (!commandBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, commandPool, static_cast<unsigned int>(commandBuffers.size()), commandBuffers.data());
+			commandBuffers.clear();
+		}
 
-		vkDestroyRenderPass(device, renderPass, nullptr);
+		// The pipeline and render pass do not depend on the extent, they are kept across swapchain recreation
 
 		for (auto imageView : swapChainImageViews)
 		{
 			vkDestroyImageView(device, imageView, nullptr);
 		}
 
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		if (config.headless)
+		{
+			for (unsigned long long i = 0; i < swapChainImages.size(); i++)
+			{
+				vkDestroyImage(device, swapChainImages[i], nullptr);
+				allocator.free(offscreenImageAllocations[i]);
+			}
+
+			swapChainImages.clear();
+			offscreenImageAllocations.clear();
+		}
+		else
+		{
+			vkDestroySwapchainKHR(device, swapChain, nullptr);
+		}
 	}
 
 	void MgeEngine::cleanUp()
 	{
+		// The device is idle by now, anything still waiting for its frame can go
+		deletionQueue.flushAll();
+
 		cleanUpSwapChain();
 
-		vkDestroyBuffer(device, indexBuffer, nullptr);
-		vkFreeMemory(device, indexBufferMemory, nullptr);
+		vkDestroyPipeline(device, graphicsPipeline, nullptr);
 
-		vkDestroyBuffer(device, vertexBuffer, nullptr);
-		vkFreeMemory(device, vertexBufferMemory, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-		for (unsigned long long i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
-		}
+		vkDestroyRenderPass(device, renderPass, nullptr);
+
+		destroyCameraResources();
+
+		allocator.destroyBuffer(indexBuffer, indexBufferAllocation);
+
+		allocator.destroyBuffer(vertexBuffer, vertexBufferAllocation);
+
+		allocator.destroyBuffer(materialBuffer, materialBufferAllocation);
+
+		destroyInstanceBuffer();
+
+		destroyCullResources();
+
+		textureManager.destroy();
+
+		renderGraph.destroy();
+
+		// After every pipeline layout built from the cached set layouts
+		bindlessTable.destroy();
+
+		descriptorAllocator.destroy();
+
+		descriptorLayoutCache.destroy();
+
+		destroyFrameSyncObjects();
+
+		vkDestroySemaphore(device, frameTimeline, nullptr);
+
+		recordingPool.stop();
+
+		gpuProfiler.destroy();
+
+		savePipelineCache();
+
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+		destroyFrameResources();
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
 
+		uploader.destroy();
+
+		allocator.destroy();
+
 		vkDestroyDevice(device, nullptr);
 
 		if (enableValidationLayers)
@@ -1412,14 +3797,60 @@ namespace mge {
 			destroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 		}
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		if (surface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(instance, surface, nullptr);
+		}
 
 		vkDestroyInstance(instance, nullptr);
 
-		glfwDestroyWindow(mainWindow);
+		if (mainWindow != nullptr)
+		{
+			glfwDestroyWindow(mainWindow);
+
+			glfwTerminate();
+		}
+
+	}
+
+	/*
+	* Retire the resources of the current swapchain without waiting for the GPU
+	*
+	* Frames that are still in flight keep using the old framebuffers, image views and command buffers,
+	* so they go to the deletion queue tagged with the last submitted serial and are destroyed once
+	* the frame timeline has reached that serial. The swapchain handle itself stays in swapChain so it can be
+	* passed as oldSwapchain to the new one.
+	*/
+	void MgeEngine::retireSwapChainResources()
+	{
+		VkDevice logicalDevice = device;
+		VkCommandPool pool = commandPool;
+
+		std::vector<VkFramebuffer> oldFrameBuffers = std::move(swapChainFrameBuffers);
+		std::vector<VkCommandBuffer> oldCommandBuffers = std::move(commandBuffers);
+		std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+
+		swapChainFrameBuffers.clear();
+		commandBuffers.clear();
+		swapChainImageViews.clear();
+
+		deletionQueue.push(submissionSerial, [=]()
+			{
+				for (auto frameBuffer : oldFrameBuffers)
+				{
+					vkDestroyFramebuffer(logicalDevice, frameBuffer, nullptr);
+				}
 
-		glfwTerminate();
+				if (!oldCommandBuffers.empty())
+				{
+					vkFreeCommandBuffers(logicalDevice, pool, static_cast<unsigned int>(oldCommandBuffers.size()), oldCommandBuffers.data());
+				}
 
+				for (auto imageView : oldImageViews)
+				{
+					vkDestroyImageView(logicalDevice, imageView, nullptr);
+				}
+			});
 	}
 
 	void MgeEngine::recreateSwapChain()
@@ -1433,19 +3864,70 @@ namespace mge {
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(device);
+		/*
+		* No vkDeviceWaitIdle here. The new swapchain is created from the old one, and everything the
+		* frames in flight still reference is retired through the deletion queue instead of destroyed.
+		*/
 
-		cleanUpSwapChain();
+		VkFormat oldImageFormat = swapChainImageFormat;
+		VkSwapchainKHR oldSwapChain = swapChain;
+
+		retireSwapChainResources();
+
+		// Cached descriptor sets may reference what was just retired
+		descriptorAllocator.invalidate();
+
+		// Presents to the old swapchain can no longer be waited on
+		pendingPresents.clear();
+
+		createSwapChain(oldSwapChain);
+
+		VkDevice logicalDevice = device;
+
+		deletionQueue.push(submissionSerial, [=]()
+			{
+				vkDestroySwapchainKHR(logicalDevice, oldSwapChain, nullptr);
+			});
 
-		// re-create swapchain
-		createSwapChain();
 		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createFrameBuffers();
+
+		// More images than before may need more profiler, uniform ring and descriptor slots (pre-recorded mode uses the image index)
+		if (getRequiredFrameSlots() > frameSlotCount)
+		{
+			resizeFrameSlots();
+		}
+
+		// The render pass (and the pipeline built against it, or with its attachment format) only has to change with the surface format
+		if (swapChainImageFormat != oldImageFormat)
+		{
+			VkPipeline oldPipeline = graphicsPipeline;
+			VkPipelineLayout oldPipelineLayout = pipelineLayout;
+			VkRenderPass oldRenderPass = renderPass;
+
+			deletionQueue.push(submissionSerial, [=]()
+				{
+					vkDestroyPipeline(logicalDevice, oldPipeline, nullptr);
+					vkDestroyPipelineLayout(logicalDevice, oldPipelineLayout, nullptr);
+					vkDestroyRenderPass(logicalDevice, oldRenderPass, nullptr);
+				});
+
+			if (config.renderBackend == MgeRenderBackend::RenderPass)
+			{
+				createRenderPass();
+			}
+
+			createGraphicsPipeline();
+		}
+
+		if (config.renderBackend == MgeRenderBackend::RenderPass)
+		{
+			createFrameBuffers();
+		}
+
 		createCommandBuffers();
 
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+		// The new images have never been submitted, none of the old image serials apply to them
+		imageSubmissions.assign(swapChainImages.size(), 0);
 
 	}
 
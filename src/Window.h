@@ -6,6 +6,7 @@
 #include <GLFW/glfw3.h>
 
 #include <GLM/glm.hpp>
+#include <GLM/gtc/matrix_transform.hpp>
 //#include <glm/vec4.hpp>
 //#include <glm/mat4x4.hpp>
 
@@ -21,6 +22,26 @@
 #include <set>
 #include <fstream>
 #include <array>
+#include <chrono>
+#include <deque>
+#include <cmath>
+#include <iomanip>
+#include <filesystem>
+
+#include "Benchmark.h"
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorLayoutCache.h"
+#include "FrameLimiter.h"
+#include "GpuProfiler.h"
+#include "MemoryAllocator.h"
+#include "RenderGraph.h"
+#include "TextureManager.h"
+#include "ThreadPool.h"
+#include "UniformRing.h"
+#include "UploadBatcher.h"
+#include "VertexLayout.h"
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -29,6 +50,141 @@ const bool enableValidationLayers = true;
 #endif
 
 namespace mge {
+
+	/*
+	* How the draw command buffers are produced
+	*
+	* PreRecorded : one command buffer per swapchain image, recorded once and resubmitted every frame.
+	*               Cheapest on the CPU but nothing drawn can change without re-recording them all.
+	* PerFrame    : every frame in flight owns a transient command pool. It is reset once the frame's
+	*               previous submission has finished and the frame is recorded again from scratch.
+	*/
+	enum class MgeCommandRecording
+	{
+		PreRecorded,
+		PerFrame
+	};
+
+	/*
+	* How the main pass targets the swapchain image
+	*
+	* RenderPass : a VkRenderPass and one VkFramebuffer per swapchain image, the layout transitions
+	*              come from the attachment's initial / final layout and the subpass dependency.
+	* Dynamic    : vkCmdBeginRendering straight on the image view (Vulkan 1.3 dynamic rendering). No
+	*              render pass or framebuffers to create, the transitions are recorded as
+	*              synchronization2 image barriers around the pass.
+	*/
+	enum class MgeRenderBackend
+	{
+		RenderPass,
+		Dynamic
+	};
+
+	/*
+	* Presentation policy, trading input-to-photon latency against frame rate
+	*
+	* Default     : 2 frames in flight, the configured present mode, minImageCount + 1 images.
+	* LowLatency  : 1 frame in flight, FIFO_RELAXED (or FIFO), minImageCount images. The CPU never
+	*               runs ahead of the GPU, so input sampled for a frame reaches the screen soonest.
+	* Throughput  : 3 frames in flight, IMMEDIATE (or MAILBOX), minImageCount + 2 images. The CPU and
+	*               GPU stay busy at the cost of a longer queue between them.
+	*
+	* Chosen at start-up and switchable at runtime with setPresentProfile(), which rebuilds the frame
+	* resources and the swapchain between two frames.
+	*/
+	enum class MgePresentProfile
+	{
+		Default,
+		LowLatency,
+		Throughput
+	};
+
+	/*
+	* Start-up options for the engine, normally filled in by main() from the command line.
+	*
+	* In headless mode no GLFW window, surface or swapchain is created. The engine renders into
+	* images it owns itself instead, so it can run on machines without a display (build farm,
+	* render nodes, software Vulkan drivers).
+	*/
+	struct MgeEngineConfig
+	{
+		bool headless = false;
+
+		unsigned int headlessImageCount = 3;	// Offscreen images rotated through in place of swapchain images
+
+		unsigned long long frameCount = 0;		// Stop after this many frames, 0 = run until the window is closed
+
+		VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;	// Default profile only, falls back to FIFO when not supported
+
+		MgePresentProfile presentProfile = MgePresentProfile::Default;
+
+		MgeCommandRecording commandRecording = MgeCommandRecording::PerFrame;
+
+		MgeRenderBackend renderBackend = MgeRenderBackend::RenderPass;
+
+		/*
+		* Per-frame recording only. With recordingThreads > 0 the draw list is split into that many
+		* contiguous slices, each recorded into a secondary command buffer by its own worker thread.
+		* 0 records everything inline on the main thread.
+		*/
+		unsigned int recordingThreads = 0;
+
+		unsigned int drawCount = 1;		// Draws in the draw list, laid out as a grid of quads
+
+		/*
+		* Instanced path. With instanceCount > 0 the quad is drawn instanceCount times from a per-instance
+		* vertex buffer (transform + color) in a single vkCmdDrawIndexed, or split into drawCount draws
+		* over contiguous instance ranges. instanceStress benchmarks 100k .. 1M instances.
+		*/
+		unsigned int instanceCount = 0;
+		bool instanceStress = false;
+
+		/*
+		* Instanced path only. A compute pass culls the instances against the visible region and compacts
+		* the visible ones into a list, drawn with a single vkCmdDrawIndexedIndirect.
+		*/
+		bool gpuCulling = false;
+
+		bool threadScaling = false;		// Benchmark recording with 1 .. N threads, one report per thread count
+
+		// Benchmark mode, enabled when benchmarkFrames > 0
+		unsigned int benchmarkWarmupFrames = 100;
+		unsigned int benchmarkFrames = 0;
+		std::string benchmarkReport = "benchmark.json";
+
+		std::string pipelineCacheFile = "pipeline_cache.bin";	// Empty = no on-disk pipeline cache
+
+		bool useTransferQueue = true;	// Upload on a dedicated transfer queue family when the device has one
+
+		bool packedVertices = false;	// Half float positions and 8 bit colors in the vertex buffer
+
+		/*
+		* Streaming textures. textureCount procedural textures are loaded in the background and spread
+		* over the grid draws, textureBudget caps the device memory they may hold. Per-frame recording
+		* only, pre-recorded command buffers and the instanced path keep the fallback texture.
+		*/
+		unsigned int textureCount = 0;
+		VkDeviceSize textureBudget = 256ull * 1024 * 1024;
+
+		/*
+		* Dynamic rendering backend only. With a render scale other than 1 the main pass draws into a
+		* transient image of the scaled size, blitted to the swapchain image afterwards.
+		*/
+		float renderScale = 1.0f;
+
+		/*
+		* Frame rate cap, 0 = uncapped. Capped windowed runs with VK_KHR_present_wait also hold each
+		* frame back until all but the newest of the earlier presents have reached the screen.
+		*/
+		double frameRateCap = 0.0;
+
+		/*
+		* Windowed only. Instead of drawing continuously the main loop sleeps in glfwWaitEvents and only
+		* draws when something changed: a key, a resize or expose, the camera moving or a texture arriving.
+		*/
+		bool renderOnDemand = false;
+	};
+
 	class MgeEngine
 	{
 	public:
@@ -36,6 +192,8 @@ namespace mge {
 
 		MgeEngine(int w, int h, std::string name);
 
+		MgeEngine(int w, int h, std::string name, const MgeEngineConfig& engineConfig);
+
 		int initWindow();
 
 		void initVulkan();
@@ -46,24 +204,41 @@ namespace mge {
 
 		void cleanUp();
 
+		// Per-scope GPU time and invocation counts of the most recently completed frame
+		const std::vector<MgeGpuProfiler::ScopeResult>& getGpuProfile() const { return gpuProfiler.getResults(); }
+
+		// Takes effect before the next frame, in windowed mode the P key cycles through the profiles
+		void setPresentProfile(MgePresentProfile profile);
+
+		MgePresentProfile getPresentProfile() const { return config.presentProfile; }
+
 		// ~Window();
 
 	private:
 
 		// Variable & struct Declaration
 
-		const int MAX_FRAMES_IN_FLIGHT = 2; // No of frame to process concurrently
+		unsigned int framesInFlight = 2; // No of frame to process concurrently, set by the present profile
 
-		GLFWwindow* mainWindow;
+		GLFWwindow* mainWindow = nullptr;
 
 		int width, height;
 
 		std::string windowName;
 
+		MgeEngineConfig config;
+
+		unsigned long long framesRendered = 0;
+
+		double initVulkanMilliseconds = 0.0;
+
 		VkInstance instance;
 
 		const std::string vertShaderFile = "shaders/vert.spv";
 		const std::string fragShaderFile = "shaders/frag.spv";
+		const std::string instancedVertShaderFile = "shaders/instanced_vert.spv";
+		const std::string cullShaderFile = "shaders/cull_comp.spv";
+		const std::string culledVertShaderFile = "shaders/culled_vert.spv";
 
 		VkDebugUtilsMessengerEXT debugMessenger;
 
@@ -89,19 +264,22 @@ namespace mge {
 		* on window system details.
 		*/
 
-		VkSurfaceKHR surface;
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
 
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 
 		VkDevice device;  // Logical Device
 		VkQueue graphicsQueue;
 		VkQueue presentQueue;
+		VkQueue transferQueue = VK_NULL_HANDLE;	// Only set when a dedicated transfer family is used
 
-		VkSwapchainKHR swapChain;
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 		std::vector<VkImage> swapChainImages;
 		VkFormat swapChainImageFormat;
 		VkExtent2D swapChainExtent;
 
+		VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
 		std::vector<VkImageView> swapChainImageViews;
 
 		const std::vector<const char*> validationLayers = {
@@ -117,6 +295,7 @@ namespace mge {
 		{
 			std::optional<unsigned int> graphicsFamily;
 			std::optional<uint32_t> presentFamily;  // Not all device can present
+			std::optional<unsigned int> transferFamily;	// Dedicated transfer / async compute family, if the device has one
 
 			bool isCompleted() const
 			{
@@ -164,10 +343,19 @@ namespace mge {
 
 		void createLogicalDevice();
 
-		void createSwapChain();
+		void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 
 		// End of Vulkan Initialization Function
 
+		// Headless rendering - engine owned images take the place of the swapchain images
+
+		std::vector<MgeAllocation> offscreenImageAllocations;
+		unsigned int offscreenImageIndex = 0;
+
+		void createOffscreenImages();
+
+		VkFormat chooseOffscreenFormat();
+
 
 		/*
 		* *But what if a queue family is not available? We could throw an exception in findQueueFamilies,
@@ -192,6 +380,12 @@ namespace mge {
 
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+		static bool supportsVulkan13(VkPhysicalDevice device);
+
+		bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
+
+		std::vector<const char*> getRequiredDeviceExtensions() const;
+
 		// Create Swapchain
 
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -199,9 +393,11 @@ namespace mge {
 
 		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 
+		unsigned int chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities);
+
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
-		bool getShouldClose() { return glfwWindowShouldClose(mainWindow); }
+		bool getShouldClose();
 
 
 		static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -214,9 +410,12 @@ namespace mge {
 
 		// Render Pass
 
-		VkRenderPass renderPass;
+		VkRenderPass renderPass = VK_NULL_HANDLE;	// Stays null with the dynamic rendering backend
 		void createRenderPass();
 
+		// Layout a frame leaves the swapchain (or offscreen) image in
+		VkImageLayout getFinalImageLayout() const;
+
 		// Pipeline
 
 		void createGraphicsPipeline();
@@ -229,6 +428,73 @@ namespace mge {
 
 		VkPipeline graphicsPipeline;
 
+		/*
+		* Per-frame and per-draw shader data
+		*
+		* The camera is written once per frame into the uniform ring and bound as a dynamic uniform buffer
+		* (set 0, binding 0), so the descriptor set never changes, only its dynamic offset does. Per-draw
+		* data travels in push constants. Moving the camera or any number of draws costs no map / unmap,
+		* no descriptor update and no allocation.
+		*/
+		struct CameraData	// std140 Camera block of the vertex shaders and the cull shader
+		{
+			glm::mat4 viewProjection;
+			glm::vec4 visibleRegion;	// World space region on screen, xy = min, zw = max
+		};
+
+		struct DrawConstants	// Draw push constant block of vert.spv and frag.spv
+		{
+			glm::vec4 transform;		// xy = offset, zw = scale
+			uint32_t materialBuffer;	// Bindless handle of the material table
+			uint32_t material;			// Index into it
+			uint32_t texture;			// Bindless handle of the texture, read by the fragment shader
+			uint32_t instanceBuffer;	// Bindless handle of the instance data, read by culled_vert.spv
+			uint32_t visibleInstances;	// Bindless handle of the cull pass's visible list, read by culled_vert.spv
+		};
+
+		// Room per slot for the camera and whatever else a frame sub-allocates
+		const VkDeviceSize UNIFORM_RING_SLOT_SIZE = 64 * 1024;
+
+		MgeUniformRing uniformRing;
+
+		VkDescriptorSetLayout cameraDescriptorSetLayout = VK_NULL_HANDLE;	// Owned by the layout cache
+
+		// 2D camera, the arrow keys pan and Page Up / Page Down zoom (windowed runs only)
+		glm::vec2 cameraPosition = glm::vec2(0.0f);
+		float cameraZoom = 1.0f;
+		MgeBenchmark::Clock::time_point lastCameraUpdate = MgeBenchmark::Clock::now();
+
+		// The ring and the camera set layout, needed by the pipeline layouts
+		void createCameraResources();
+
+		void destroyCameraResources();
+
+		void updateCamera();
+
+		// A camera key is held, the camera moves every frame
+		bool isCameraMoving() const;
+
+		// Writes the camera as the first allocation of the slot, the offset pre-recorded command buffers bake in
+		void writeCameraData(unsigned int slot);
+
+		/*
+		* Pipeline cache
+		*
+		* Loaded from disk at start-up and written back in cleanUp(), so pipelines compiled in an
+		* earlier run (or before a swapchain recreation) do not have to be compiled again. Every
+		* vkCreate*Pipelines call goes through it.
+		*/
+
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+		void createPipelineCache();
+
+		void savePipelineCache();
+
+		std::vector<char> loadPipelineCacheData();
+
+		static unsigned long long hashPipelineCacheData(const char* data, size_t size);
+
 		// Frame Buffer
 
 		std::vector<VkFramebuffer> swapChainFrameBuffers;
@@ -242,23 +508,260 @@ namespace mge {
 
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
-		std::vector<VkFence> imagesInFlight;
 		unsigned long long currentFrame = 0;
 
+		/*
+		* Frame timeline
+		*
+		* One timeline semaphore tracks all graphics work: every frame submission signals it with the
+		* next submission serial, so its counter value is "the GPU has finished submission N" and can
+		* be queried or waited on from anywhere on the CPU. frameSubmissions holds the serial last
+		* submitted from each frame slot and imageSubmissions the serial that last rendered to each
+		* image. Deferred deletes are keyed by the same serials.
+		*/
+		VkSemaphore frameTimeline = VK_NULL_HANDLE;
+		unsigned long long submissionSerial = 0;
+		unsigned long long completedSubmission = 0;
+		std::vector<unsigned long long> frameSubmissions;
+		std::vector<unsigned long long> imageSubmissions;
+
+		// Refreshes completedSubmission from the timeline's counter
+		unsigned long long getCompletedSubmission();
+
+		void waitForSubmission(unsigned long long serial);
+
+		MgeDeletionQueue deletionQueue;
+
+		/*
+		* Per frame-in-flight resources
+		*
+		* Used by MgeCommandRecording::PerFrame. Each frame has its own pool created with the TRANSIENT
+		* flag, and the whole pool is reset with vkResetCommandPool once the frame's previous submission
+		* has finished, which is cheaper than resetting individual command buffers.
+		*/
+		struct FrameResources
+		{
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+			// One pool + secondary command buffer per recording worker, only touched by that worker
+			std::vector<VkCommandPool> workerCommandPools;
+			std::vector<VkCommandBuffer> workerCommandBuffers;
+		};
+
+		std::vector<FrameResources> frameResources;
+
 		void createCommandPool();
 
+		void createFrameResources();
+
+		void destroyFrameResources();
+
 		void createCommandBuffers();
 
+		/*
+		* Descriptors
+		*
+		* Layouts come from the layout cache, sets from the per-slot descriptor allocator. The sets a
+		* command buffer binds are requested once per recording, before any worker thread starts, and
+		* come straight back from the allocator's cache while their contents stay the same.
+		*/
+		MgeDescriptorLayoutCache descriptorLayoutCache;
+
+		MgeDescriptorAllocator descriptorAllocator;
+
+		struct FrameDescriptors
+		{
+			VkDescriptorSet camera = VK_NULL_HANDLE;
+			VkDescriptorSet cull = VK_NULL_HANDLE;	// GPU culling only
+			uint32_t cameraOffset = 0;				// Dynamic offset of the slot's camera data
+		};
+
+		// Starts the slot in the descriptor allocator, only once nothing in flight uses the slot any more
+		FrameDescriptors beginFrameDescriptors(unsigned int slot);
+
+		void recordCommandBuffer(VkCommandBuffer commandBuffer, unsigned int imageIndex, unsigned int profilerSlot,
+			const FrameDescriptors& descriptors, const std::vector<VkCommandBuffer>& secondaryCommandBuffers = {});
+
+		// Binds the pipeline state and records draws [first, first + count) of the draw list
+		void recordDraws(VkCommandBuffer commandBuffer, size_t first, size_t count, const FrameDescriptors& descriptors);
+
+		// vkCmdBeginRenderPass on the image's framebuffer or, with the dynamic backend, vkCmdBeginRendering on target
+		void beginMainPass(VkCommandBuffer commandBuffer, unsigned int imageIndex, VkImageView target, bool secondaryContents);
+
+		void endMainPass(VkCommandBuffer commandBuffer);
+
+		// Render graph
+
+		MgeRenderGraph renderGraph;		// Declared again for every command buffer recorded
+
+		void buildFrameGraph(unsigned int imageIndex, unsigned int profilerSlot, const FrameDescriptors& descriptors,
+			const std::vector<VkCommandBuffer>& secondaryCommandBuffers);
+
+		bool usesRenderScale() const;
+
+		// Size the main pass draws at, the swapchain extent scaled by the render scale
+		VkExtent2D getRenderExtent() const;
+
+		/*
+		* Multithreaded recording
+		*
+		* Worker w records slice w of the draw list into frame.workerCommandBuffers[w]. The primary
+		* command buffer executes them in worker order, so the draw order does not depend on which
+		* thread finishes first.
+		*/
+		MgeThreadPool recordingPool;
+
+		unsigned int maxRecordingThreads = 0;		// Workers (and worker pools per frame) created
+		unsigned int activeRecordingThreads = 0;	// Workers used for the current frame
+
+		std::vector<VkCommandBuffer> recordSecondaryCommandBuffers(FrameResources& frame, unsigned int imageIndex, const FrameDescriptors& descriptors);
+
+		// Draw list
+
+		struct DrawItem
+		{
+			DrawConstants constants;	// Pushed before the draw
+			unsigned int indexCount;
+			unsigned int firstIndex;
+			int vertexOffset;
+			unsigned int firstInstance;
+			unsigned int instanceCount;
+		};
+
+		std::vector<DrawItem> drawList;
+
+		void buildDrawList();
+
+		static const char* commandRecordingName(MgeCommandRecording recording);
+
+		static const char* renderBackendName(MgeRenderBackend backend);
+
 		void createSyncObjects();
 
-		void drawFrame();
+		// The per-frame semaphores, rebuilt when the number of frames in flight changes
+		void createFrameSyncObjects();
+
+		void destroyFrameSyncObjects();
+
+		// False when nothing was rendered (the swapchain was out of date and got recreated instead)
+		bool drawFrame();
+
+		/*
+		* Input latency
+		*
+		* drawFrame() polls events and moves the camera only after the frame's waits and recording, right
+		* before the camera is written, so the input is as fresh as it can be when the GPU reads it.
+		* The time of that sample follows the frame to vkQueuePresentKHR and, with VK_KHR_present_id and
+		* VK_KHR_present_wait, to the moment the image was actually presented (input_to_present_ms).
+		*/
+		MgeBenchmark::Clock::time_point inputSampleTime = MgeBenchmark::Clock::now();
+
+		struct PendingPresent
+		{
+			uint64_t id = 0;
+			MgeBenchmark::Clock::time_point inputTime;
+		};
+
+		bool presentWaitEnabled = false;
+		PFN_vkWaitForPresentKHR waitForPresent = nullptr;	// Loaded from the device
+		uint64_t presentId = 0;
+		std::deque<PendingPresent> pendingPresents;	// Oldest first
+
+		void sampleInput();
+
+		// Records the latency of every present that has completed since the last call, never blocks
+		void collectPresents();
+
+		// Present profile
+
+		std::optional<MgePresentProfile> pendingPresentProfile;
+
+		// Drains the GPU and rebuilds everything sized by the frames in flight or the present policy
+		void applyPresentProfile();
+
+		static unsigned int getProfileFramesInFlight(MgePresentProfile profile);
+
+		static const char* presentProfileName(MgePresentProfile profile);
+
+		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+		// Benchmark
+
+		MgeBenchmark benchmark;
+
+		void reportBenchmark(const std::string& reportFile);
+
+		void runFrames();
+
+		// Present wait pacing gives up after this long (a minimized window never presents)
+		const uint64_t PRESENT_PACING_TIMEOUT_NS = 100ull * 1000 * 1000;
+
+		MgeFrameLimiter frameLimiter;
+
+		/*
+		* Render on demand
+		*
+		* Anything that changes what is on screen only once (a key, a resize, an expose) sets
+		* redrawRequested from its callback. Changes spread over several frames (the camera moving,
+		* textures uploading or streaming) are polled as animations. With neither, the loop blocks in
+		* glfwWaitEvents; the texture loader thread posts an empty event when a load finishes.
+		*/
+		bool redrawRequested = true;
+		unsigned long long idleWakeups = 0;		// glfwWaitEvents returned with nothing to draw
+
+		// Blocks until there is something to draw, false when the loop should check again (closing, nothing changed)
+		bool waitForRedraw();
+
+		bool isAnimating() const;
+
+		static void windowRefreshCallback(GLFWwindow* window);
+
+		// Waits for the display (present wait) and the frame rate cap before a frame starts
+		void paceFrame();
+
+		void runThreadScaling();
+
+		// Instance counts of the instanced stress benchmark
+		const std::vector<unsigned int> INSTANCE_STRESS_COUNTS = { 100000, 250000, 500000, 1000000 };
+
+		void runInstanceStress();
+
+		static const char* presentModeName(VkPresentModeKHR presentMode);
+
+		// GPU profiling
+
+		/*
+		* Query slots in the GPU profiler. Pre-recorded command buffers bake their query indices in,
+		* so they use the swapchain image index as slot; this has to cover the image count.
+		* Per-frame recording uses the frame-in-flight index instead. The uniform ring and the
+		* descriptor allocator use the same slots. The driver may hand out more swapchain images than
+		* asked for, so the slot count grows with the image count (resizeFrameSlots).
+		*/
+		const unsigned int MIN_FRAME_SLOTS = 8;
+
+		unsigned int frameSlotCount = 0;
+
+		unsigned int getRequiredFrameSlots() const;
+
+		// Re-creates the profiler, the uniform ring and the descriptor allocator with getRequiredFrameSlots() slots
+		void resizeFrameSlots();
+
+		MgeGpuProfiler gpuProfiler;
+
+		bool pipelineStatisticsEnabled = false;
+
+		// Secondary command buffers may run inside an active pipeline statistics query
+		bool inheritedQueriesEnabled = false;
+
+		void collectGpuProfile(unsigned int slot);
 
 		// Swapchain Recreation
 		bool frameBufferResize = false;
 
 		static void frameBufferResizeCallback(GLFWwindow* window, int width, int height);
 		void cleanUpSwapChain();
+		void retireSwapChainResources();
 		void recreateSwapChain();
 
 		// Vertex Input
@@ -266,39 +769,44 @@ namespace mge {
 		{
 			glm::vec2 pos;
 			glm::vec3 color;
+		};
 
-			// pass this to vertex shader
-
-			static VkVertexInputBindingDescription getBindingDescription()
-			{
-				VkVertexInputBindingDescription bindingDescription{};
-				bindingDescription.binding = 0;
-				bindingDescription.stride = sizeof(Vertex);
-				bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-				return bindingDescription;
-			}
-
-			static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
-			{
-				std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		// pass this to vertex shader : location 0 (position), location 1 (color)
+		using VertexLayout = MgeVertexLayout<Vertex, VK_VERTEX_INPUT_RATE_VERTEX,
+			MGE_VERTEX_FIELD(Vertex, pos), MGE_VERTEX_FIELD(Vertex, color)>;
 
-				// binding vertex
-				attributeDescriptions[0].binding = 0;
-				attributeDescriptions[0].location = 0; // location 0 (position) in the vertex shader
-				attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-				attributeDescriptions[0].offset = offsetof(Vertex, pos);
+		/*
+		* Packed vertex, 8 bytes instead of 20
+		*
+		* Half float position and an 8 bit per channel color. The input assembler converts both back to
+		* floats, so it feeds the same vertex shaders as Vertex.
+		*/
+		struct PackedVertex
+		{
+			MgeHalf2 pos;
+			MgeUnorm8x4 color;
+		};
 
-				// binding color
-				attributeDescriptions[1].binding = 0;
-				attributeDescriptions[1].location = 1; // location 1 (color) in the vertex shader
-				attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-				attributeDescriptions[1].offset = offsetof(Vertex, color);
+		using PackedVertexLayout = MgeVertexLayout<PackedVertex, VK_VERTEX_INPUT_RATE_VERTEX,
+			MGE_VERTEX_FIELD(PackedVertex, pos), MGE_VERTEX_FIELD(PackedVertex, color)>;
 
-				return attributeDescriptions;
-			}
+		/*
+		* Per-instance vertex input
+		*
+		* Binding 1 advances once per instance instead of once per vertex. The instanced vertex shader
+		* scales and offsets the quad with the transform and tints it with the color. The cull shader
+		* reads the same struct as std430, keep the two in step.
+		*/
+		struct InstanceData
+		{
+			glm::vec4 transform;	// xy = offset, zw = scale
+			glm::vec4 color;
 		};
 
+		// location 2 (transform), location 3 (instance color) in the instanced vertex shader
+		using InstanceLayout = MgeVertexLayout<InstanceData, VK_VERTEX_INPUT_RATE_INSTANCE,
+			MGE_VERTEX_FIELD(InstanceData, transform), MGE_VERTEX_FIELD(InstanceData, color)>;
+
 		const std::vector<Vertex> vertices =
 		{
 			{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
@@ -320,21 +828,138 @@ namespace mge {
 			0, 1, 2, 2, 3, 0
 		};
 
+		/*
+		* Bindless resources
+		*
+		* Set 1 of the graphics pipeline layout is the global bindless table, bound once per command
+		* buffer next to the camera. Draws select their resources by handle, so consecutive draws with
+		* different materials need no descriptor binds.
+		*/
+		MgeBindlessTable bindlessTable;
+
+		// std430 Material of vert.spv
+		struct MaterialData
+		{
+			glm::vec4 color;
+		};
+
+		// Material table in a bindless storage buffer, draws pick an entry with their push constants
+		const std::vector<MaterialData> materials =
+		{
+			{{ 1.0f, 1.0f, 1.0f, 1.0f }},
+			{{ 1.0f, 0.4f, 0.4f, 1.0f }},
+			{{ 0.4f, 1.0f, 0.4f, 1.0f }},
+			{{ 0.4f, 0.4f, 1.0f, 1.0f }},
+			{{ 1.0f, 1.0f, 0.4f, 1.0f }},
+			{{ 0.4f, 1.0f, 1.0f, 1.0f }},
+			{{ 1.0f, 0.4f, 1.0f, 1.0f }},
+			{{ 0.6f, 0.6f, 0.6f, 1.0f }}
+		};
+
+		VkBuffer materialBuffer = VK_NULL_HANDLE;
+		MgeAllocation materialBufferAllocation;
+		uint32_t materialBufferHandle = MGE_INVALID_BINDLESS_HANDLE;
+
+		void createMaterialBuffer();
+
+		/*
+		* Textures
+		*
+		* Loaded and streamed by the texture manager. Grid draw i samples textures[i % count]; before
+		* every per-frame recording the draws pick up the textures' current bindless handles and
+		* the visible ones report their on-screen size, which drives residency.
+		*/
+		MgeTextureManager textureManager;
+
+		std::vector<MgeTextureId> textures;
+
+		static const uint32_t TEXTURE_SIZE = 512;
+
+		void loadTextures();
+
+		void updateTextures();
+
+		// Checkerboard in a tint per index. Even indices come with a full mip chain, odd ones leave it to the GPU.
+		static MgeTextureData createCheckerTexture(unsigned int index);
+
 		// Vertex Buffer
 		VkBuffer vertexBuffer;
-		VkDeviceMemory vertexBufferMemory;
+		MgeAllocation vertexBufferAllocation;
 		VkBuffer indexBuffer;
-		VkDeviceMemory indexBufferMemory;
+		MgeAllocation indexBufferAllocation;
 
 		void createVertexBuffer();
 		void createIndexBuffer();
 
+		// Instance Buffer - device local, filled through the uploader
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+		MgeAllocation instanceBufferAllocation;
+
+		void createInstanceBuffer();
+
+		void destroyInstanceBuffer();
+
+		// Replaces the instance buffer and everything recorded against it, drains the GPU
+		void setInstanceCount(unsigned int count);
+
+		/*
+		* GPU culling
+		*
+		* cull_comp.spv runs one invocation per instance. indirectBuffer holds a single
+		* VkDrawIndexedIndirectCommand for the instanced mesh, recorded with instanceCount 0 before the
+		* pass. Every instance overlapping the camera's visible region (binding 3, the same ring
+		* allocation the vertex shader reads) bumps that instanceCount with an atomic add and writes its
+		* index into the slot it got in visibleInstanceBuffer. One vkCmdDrawIndexedIndirect then draws
+		* exactly the visible instances, culled_vert.spv looks each one up through the compacted list
+		* (both buffers reach it through the bindless table). The CPU cost of a frame no longer depends
+		* on how many objects there are, and the GPU side costs 4 bytes per instance.
+		*/
+		struct CullPushConstants
+		{
+			unsigned int objectCount;
+		};
 
-		unsigned int findMemoryType(unsigned int typeFilter, VkMemoryPropertyFlags properties);
+		const unsigned int CULL_WORKGROUP_SIZE = 64;	// local_size_x in cull.comp
+
+		VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;	// Owned by the layout cache
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline cullPipeline = VK_NULL_HANDLE;
+
+		VkBuffer indirectBuffer = VK_NULL_HANDLE;
+		MgeAllocation indirectBufferAllocation;
+		VkBuffer visibleInstanceBuffer = VK_NULL_HANDLE;
+		MgeAllocation visibleInstanceBufferAllocation;
+
+		// Bindless handles culled_vert.spv reads the instances through
+		uint32_t instanceBufferHandle = MGE_INVALID_BINDLESS_HANDLE;
+		uint32_t visibleInstanceBufferHandle = MGE_INVALID_BINDLESS_HANDLE;
+
+		void createCullPipeline();
+
+		// Sized for the instance count, the next cull set requested points at them
+		void createCullBuffers();
+
+		void destroyCullResources();
+
+		// Culling dispatch plus the barriers around it, recorded before the render pass
+		void recordCulling(VkCommandBuffer commandBuffer, unsigned int profilerSlot, const FrameDescriptors& descriptors);
+
+
+		/*
+		* Device memory
+		*
+		* All buffer and image memory is sub-allocated from large blocks by the allocator, so the
+		* engine never calls vkAllocateMemory per resource.
+		*/
+		MgeAllocator allocator;
 
 		// Staging Buffer
-		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory&bufferMemory);
-		
-		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, MgeAllocation& bufferAllocation);
+
+		/*
+		* Uploads go through a persistently mapped staging ring and are submitted in batches,
+		* see MgeUploadBatcher. Finished batches are collected once per frame.
+		*/
+		MgeUploadBatcher uploader;
 	};
 }